@@ -1617,10 +1617,8 @@ XML_Parse(XML_Parser parser, const char *s, int len, int isFinal)
     else {
       //memcpy(buff, s, len);
 
-			char *tmp = (char *)buff;
-			for(int i=0; i<len; i++){
-				CREST_char(tmp[i]);
-			}
+			if (len > 0)
+				CREST_buffer(buff, len, __CREST_CHAR);
       return XML_ParseBuffer(parser, len, isFinal);
     }
   }
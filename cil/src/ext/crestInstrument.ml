@@ -203,6 +203,96 @@ let noAddr = zero
 
 let shouldSkipFunction f = hasAttribute "crest_skip" f.vattr
 
+
+(*
+ * Optional function list restricting which functions are instrumented.
+ * With --crestIncludeFuncs only the listed functions are instrumented;
+ * with --crestExcludeFuncs every function except the listed ones is.
+ * The file holds one function name per line ('#' starts a comment).
+ *
+ * Uninstrumented functions run natively: calls to them are instrumented
+ * exactly like calls to library functions, so the runtime discards their
+ * arguments and pushes the concrete return value (see HandleReturn in
+ * base/symbolic_interpreter.cc).  As with library code, they must not
+ * call back into instrumented functions.
+ *)
+let funcListFile = ref ""
+let funcListIsInclude = ref false
+let funcList = ref None
+
+let readFuncList fname =
+  let tbl = Hashtbl.create 97 in
+  let trim s =
+    let s = try String.sub s 0 (String.index s '#') with Not_found -> s in
+      String.trim s
+  in
+    (try
+       let f = open_in fname in
+         (try
+            while true do
+              let name = trim (input_line f) in
+                if name <> "" then Hashtbl.replace tbl name ()
+            done
+          with End_of_file -> close_in f)
+     with Sys_error _ ->
+       failwith ("Failed to read function list: " ^ fname ^ "\n")) ;
+    tbl
+
+let isFunctionListed f =
+  match !funcList with
+    | Some tbl -> Hashtbl.mem tbl f.vname
+    | None ->
+        let tbl = readFuncList !funcListFile in
+          funcList := Some tbl ;
+          Hashtbl.mem tbl f.vname
+
+let shouldExcludeFunction f =
+  if !funcListFile = "" then
+    false
+  else
+    (isFunctionListed f) <> !funcListIsInclude
+
+(*
+ * An instrumented function pops its symbolic arguments on entry and
+ * pushes its return value on exit, so a call to it from uninstrumented
+ * code, which pushes nothing, leaves the symbolic call stack out of
+ * step.  We reject direct calls from an excluded function to a function
+ * that is instrumented: one listed with --crestIncludeFuncs, or one
+ * defined in the same file and not excluded.  Calls through function
+ * pointers cannot be checked.
+ *)
+let isInstrumentedFunction (defined : (string, unit) Hashtbl.t) f =
+  (not (shouldSkipFunction f)) && (not (shouldExcludeFunction f)) &&
+  ((!funcListIsInclude && isFunctionListed f) || Hashtbl.mem defined f.vname)
+
+class excludedCallVisitor defined (caller : varinfo) =
+object
+  inherit nopCilVisitor
+
+  method vinst(i) =
+    match i with
+      | Call (_, Lval (Var f, NoOffset), _, _)
+          when isInstrumentedFunction defined f ->
+          failwith ("Uninstrumented function " ^ caller.vname ^
+                    " calls instrumented function " ^ f.vname ^
+                    "; add both to, or remove both from, the function list.\n")
+      | _ -> SkipChildren
+end
+
+let checkExcludedCalls (file : file) =
+  if !funcListFile <> "" then
+    let defined = Hashtbl.create 97 in
+      iterGlobals file
+        (function GFun (fd, _) -> Hashtbl.replace defined fd.svar.vname ()
+                | _ -> ()) ;
+      iterGlobals file
+        (function
+           | GFun (fd, _) when (shouldExcludeFunction fd.svar)
+                               && (not (shouldSkipFunction fd.svar)) ->
+               ignore (visitCilFunction
+                         (new excludedCallVisitor defined fd.svar :> cilVisitor) fd)
+           | _ -> ())
+
 let prependToBlock (is : instr list) (b : block) =
   b.bstmts <- mkStmt (Instr is) :: b.bstmts
 
@@ -478,6 +568,12 @@ object (self)
       (* By Hyunmin Bug fix. *)
       (funCount := !funCount + 1 ;
       SkipChildren)
+    else if shouldExcludeFunction f.svar then
+      (* Keep the function's (empty) slot in "branches", so that function
+       * and branch ids of the instrumented functions do not depend on
+       * the function list. *)
+      (addFunction () ;
+       SkipChildren)
     else
       let instParam v = mkStore (addressOf (var v)) in
       let isSymbolic v = isSymbolicType v.vtype in
@@ -512,7 +608,14 @@ let feature : featureDescr =
   { fd_name = "CrestInstrument";
     fd_enabled = ref false;
     fd_description = "instrument a program for use with CREST";
-    fd_extraopt = [];
+    fd_extraopt = [
+      ("--crestIncludeFuncs",
+       Arg.String (fun s -> funcListFile := s ; funcListIsInclude := true),
+       " instrument only the functions listed in the given file");
+      ("--crestExcludeFuncs",
+       Arg.String (fun s -> funcListFile := s ; funcListIsInclude := false),
+       " do not instrument the functions listed in the given file")
+    ];
     fd_post_check = true;
     fd_doit =
       function (f: file) ->
@@ -547,6 +650,8 @@ let feature : featureDescr =
            * and by explicitly adding edges for calls to functions
            * defined in this file. *)
           handleCallEdgesAndWriteCfg f ;
+          (* Uninstrumented functions must not call instrumented ones. *)
+          checkExcludedCalls f ;
           (* Finally instrument the program. *)
 	  (let instVisitor = new crestInstrumentVisitor f in
              visitCilFileSameGlobals (instVisitor :> cilVisitor) f) ;
@@ -127,6 +127,8 @@
 
 #define __CREST_OP int
 #define __CREST_BOOL unsigned char
+#define __CREST_TYPE int
+#define __CREST_SIZE unsigned long int
 
 /*
  * Constants representing possible C operators.
@@ -164,6 +166,22 @@ typedef enum {
   __CREST_L_NOT     = 21,
 };
 
+/*
+ * Constants representing the C types of symbolic buffer elements.
+ */
+typedef enum {
+  __CREST_U_CHAR      = 0,
+  __CREST_CHAR        = 1,
+  __CREST_U_SHORT     = 2,
+  __CREST_SHORT       = 3,
+  __CREST_U_INT       = 4,
+  __CREST_INT         = 5,
+  __CREST_U_LONG      = 6,
+  __CREST_LONG        = 7,
+  __CREST_U_LONG_LONG = 8,
+  __CREST_LONG_LONG   = 9,
+};
+
 /*
  * Short-cut to indicate that a function should be skipped during
  * instrumentation.
@@ -201,4 +219,23 @@ EXTERN void __CrestChar(char* x) __SKIP;
 EXTERN void __CrestShort(short* x) __SKIP;
 EXTERN void __CrestInt(int* x) __SKIP;
 
+/*
+ * Marks a whole buffer of 'len' elements of the given type (e.g.
+ * __CREST_CHAR) as symbolic in a single call.  The elements become
+ * consecutive inputs, exactly as if each were marked individually.
+ */
+#define CREST_buffer(x, len, type) __CrestBuffer((x), (len), (type))
+
+EXTERN void __CrestBuffer(void* x, __CREST_SIZE len, __CREST_TYPE type) __SKIP;
+
+/*
+ * Symbolic file input.
+ *
+ * When a program is linked with "-Wl,--wrap=read,--wrap=fread", every
+ * read() or fread() from a file listed in the CREST_SYMBOLIC_FILES
+ * environment variable (colon-separated paths; "-" for stdin) marks the
+ * bytes read as symbolic unsigned chars.  The bytes read from the file
+ * are used as the initial values of new inputs.
+ */
+
 #endif  /* LIBCREST_CREST_H__ */
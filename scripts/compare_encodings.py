@@ -0,0 +1,128 @@
+import os
+import re
+import json
+import argparse
+import datetime
+
+from multiprocessing import Process
+
+# Runs a benchmark with the integer and the bit-vector solver encodings
+# (run_crest --bitvector_solver) and compares their prediction failures,
+# executions per new branch, and coverage.
+#
+#   python compare_encodings.py pgm_config/replace.json \
+#       ../benchmarks/small_benchmarks/replace/replace.w 5
+
+start_time = datetime.datetime.now()
+
+configs = {
+	'script_path': os.path.abspath(os.getcwd()),
+	'crest_path': os.path.abspath('../bin/run_crest'),
+	'n_exec': 4000,
+	'date': start_time.strftime('%m%d'),
+	'top_dir': os.path.abspath('../experiments/')
+}
+
+encodings = [('integer', ''), ('bitvector', '--bitvector_solver')]
+
+def load_pgm_config(config_file):
+	with open(config_file, 'r') as f:
+		parsed = json.load(f)
+
+	return parsed
+
+def input_file(pgm_name):
+	if pgm_name.find('expat-') >= 0:
+		return "expat.input"
+	if pgm_name == 'grep-2.2':
+		return "grep.input"
+	if pgm_name == 'gawk-3.0.3':
+		return "gawk.input"
+	if pgm_name.find('sed-') >= 0:
+		return "sed.input"
+	if pgm_name == 'vim-5.7':
+		return "vim.input"
+	if pgm_name == 'tree-1.6.0':
+		return "tree.input"
+	return pgm_name + ".input"
+
+def running_function(pgm_config, top_dir, weight, encoding, option, run):
+	instance_dir = "/".join([top_dir, encoding + "__" + str(run)])
+	os.system(" ".join(["cp -r", pgm_config['pgm_dir'], instance_dir]))
+	os.chdir(instance_dir)
+	os.chdir(pgm_config['exec_dir'])
+
+	run_cmd = " ".join([configs['crest_path'], pgm_config['exec_cmd'],
+		input_file(pgm_config['pgm_name']), "log", str(configs['n_exec']),
+		"-param", weight, option, "2> /dev/null"])
+	print(run_cmd)
+	os.system(run_cmd)
+
+def read_log(log):
+	# (prediction failures, prediction checks, executions, new branches,
+	# covered branches), or None if the run did not finish.
+	checks = execs = covered = None
+	with open(log, 'r') as f:
+		for line in f:
+			m = re.match(r"Prediction failures: (\d+) / (\d+)", line)
+			if m:
+				checks = (int(m.group(1)), int(m.group(2)))
+			m = re.match(r"Executions per new branch: \S+ \((\d+) executions, (\d+) new", line)
+			if m:
+				execs = (int(m.group(1)), int(m.group(2)))
+			m = re.match(r"It: \d+, Time: \d+, covered: (\d+)", line)
+			if m:
+				covered = int(m.group(1))
+	if checks is None or execs is None or covered is None:
+		return None
+	return checks + execs + (covered,)
+
+def run_all(pgm_config, weight, n_runs):
+	top_dir = "/".join([configs['top_dir'], configs['date'] + "__encodings", pgm_config['pgm_name']])
+	os.makedirs(top_dir)
+
+	procs = []
+	for (encoding, option) in encodings:
+		for run in range(1, n_runs+1):
+			procs.append(Process(target=running_function,
+					args=(pgm_config, top_dir, weight, encoding, option, run)))
+	for p in procs:
+		p.start()
+	for p in procs:
+		p.join()
+
+	print("%-10s %5s %9s %12s %16s" % ("encoding", "runs", "covered", "pred. fail", "execs/new br."))
+	for (encoding, option) in encodings:
+		results = []
+		for run in range(1, n_runs+1):
+			log = "/".join([top_dir, encoding + "__" + str(run), pgm_config['exec_dir'], "log"])
+			if os.path.exists(log):
+				result = read_log(log)
+				if result is not None:
+					results.append(result)
+		if not results:
+			print("%-10s %5d" % (encoding, 0))
+			continue
+		n = float(len(results))
+		failures = sum(r[0] for r in results)
+		checks = sum(r[1] for r in results)
+		execs = sum(r[2] for r in results)
+		new_branches = sum(r[3] for r in results)
+		print("%-10s %5d %9.1f %11.2f%% %16.2f" % (encoding, len(results),
+			sum(r[4] for r in results) / n,
+			100.0 * failures / max(checks, 1),
+			float(execs) / max(new_branches, 1)))
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser()
+
+	parser.add_argument("pgm_config")
+	parser.add_argument("weight")
+	parser.add_argument("n_runs")
+	parser.add_argument("-n", "--n_exec", type=int, default=4000)
+
+	args = parser.parse_args()
+	pgm_config = load_pgm_config(args.pgm_config)
+	configs['n_exec'] = args.n_exec
+
+	run_all(pgm_config, os.path.abspath(args.weight), int(args.n_runs))
@@ -19,7 +19,9 @@ configs = {
 	'crest_path': os.path.abspath('../bin/run_crest'),
 	'n_exec': 4000,
 	'date': date,
-	'top_dir': os.path.abspath('../experiments/')
+	'top_dir': os.path.abspath('../experiments/'),
+	# Solver results shared by all run_crest processes on the same program
+	'solver_cache_dir': os.path.abspath('../experiments/solver_cache')
 }
 
 def load_pgm_config(config_file):
@@ -59,7 +61,8 @@ def gen_run_cmd(pgm_config, idx):
 	weight = configs['script_path'] +"/"+ args.trial + "_weights/" + str(idx) + ".weight"
 	
 	run_cmd = " ".join([crest, exec_cmd, input, log, n_exec,
-		"-param", weight, "features", "dominator"])
+		"-param", weight, "features", "dominator",
+		"--solver_cache_dir=" + configs['solver_cache_dir']])
 
 	return (run_cmd, log)
 
@@ -19,7 +19,9 @@ configs = {
 	'crest_path': os.path.abspath('../bin/run_crest'),
 	'n_exec': 4000,
 	'date': datetime.datetime.now().strftime('%m'),
-	'top_dir': os.path.abspath('../experiments/')
+	'top_dir': os.path.abspath('../experiments/'),
+	# Solver results shared by all run_crest processes on the same program
+	'solver_cache_dir': os.path.abspath('../experiments/solver_cache')
 }
 
 def load_pgm_config(config_file):
@@ -102,7 +104,8 @@ def gen_run_cmd(pgm_config, weight_idx, iter):
 	log = "logs/" + "__".join([pgm_name+"check"+args.trial, str(weight_idx), "ours", str(iter)]) + ".log"
 	weight = configs['script_path'] +"/"+ str(trial)+ "_weights/" + str(weight_idx) + ".weight"
 
-	run_cmd = " ".join([crest, exec_cmd, input, log, n_exec, "-param", weight])
+	run_cmd = " ".join([crest, exec_cmd, input, log, n_exec, "-param", weight,
+		"--solver_cache_dir=" + configs['solver_cache_dir']])
 	print run_cmd
 
 	return (run_cmd, log)
@@ -21,6 +21,7 @@ typedef unsigned int function_id_t;
 typedef unsigned int var_t;
 typedef long long int value_t;
 typedef unsigned long int addr_t;
+typedef unsigned long long int hash_t;
 
 
 // Virtual "branch ID's" used to represent function calls and returns.
@@ -0,0 +1,260 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <assert.h>
+#include <utility>
+
+#include "base/fast_solver.h"
+
+using std::make_pair;
+using std::sort;
+using std::unique;
+
+namespace crest {
+
+namespace {
+
+// Wide enough that sums of a few 64-bit bounds cannot overflow.
+typedef __int128 wide_t;
+
+const size_t kMaxVars = 32;
+const size_t kMaxConstraints = 256;
+const wide_t kInfinity = static_cast<wide_t>(1) << 100;
+
+typedef vector<const SymbolicPred*>::const_iterator PredIt;
+typedef map<var_t,type_t>::const_iterator VarIt;
+
+wide_t FloorDiv(wide_t a, wide_t b) {
+  wide_t q = a / b;
+  if ((a % b != 0) && ((a < 0) != (b < 0)))
+    q--;
+  return q;
+}
+
+wide_t CeilDiv(wide_t a, wide_t b) {
+  return -FloorDiv(-a, b);
+}
+
+// A system of difference constraints x_to - x_from <= w over variables
+// 0..n-1 and a "zero" node n, through which variable bounds are expressed.
+class DiffSystem {
+ public:
+  explicit DiffSystem(size_t n) : n_(n) { }
+
+  void AddUpper(size_t x, wide_t u) { Add(n_, x, u); }
+  void AddLower(size_t x, wide_t l) { Add(x, n_, -l); }
+  // x_p - x_q <= k.
+  void AddDiff(size_t p, size_t q, wide_t k) { Add(q, p, k); }
+
+  // Computes the exact range [lb, ub] of every variable.  Returns false
+  // if the system is inconsistent (has a negative cycle).
+  bool Ranges(vector<wide_t>* lb, vector<wide_t>* ub) const;
+
+ private:
+  struct Edge {
+    size_t from, to;
+    wide_t w;
+  };
+
+  void Add(size_t from, size_t to, wide_t w) {
+    Edge e = { from, to, w };
+    edges_.push_back(e);
+  }
+
+  const size_t n_;
+  vector<Edge> edges_;
+};
+
+bool DiffSystem::Ranges(vector<wide_t>* lb, vector<wide_t>* ub) const {
+  // Shortest distances from the zero node give upper bounds; shortest
+  // distances to it give (negated) lower bounds.
+  vector<wide_t> from_zero(n_ + 1, kInfinity), to_zero(n_ + 1, kInfinity);
+  from_zero[n_] = to_zero[n_] = 0;
+  for (size_t round = 0; round <= n_ + 1; round++) {
+    bool changed = false;
+    for (size_t i = 0; i < edges_.size(); i++) {
+      const Edge& e = edges_[i];
+      if ((from_zero[e.from] < kInfinity)
+          && (from_zero[e.from] + e.w < from_zero[e.to])) {
+        from_zero[e.to] = from_zero[e.from] + e.w;
+        changed = true;
+      }
+      if ((to_zero[e.to] < kInfinity)
+          && (to_zero[e.to] + e.w < to_zero[e.from])) {
+        to_zero[e.from] = to_zero[e.to] + e.w;
+        changed = true;
+      }
+    }
+    if (!changed) {
+      lb->resize(n_);
+      ub->resize(n_);
+      for (size_t x = 0; x < n_; x++) {
+        (*lb)[x] = -to_zero[x];
+        (*ub)[x] = from_zero[x];
+      }
+      return true;
+    }
+  }
+  // Still changing after n+1 rounds: a negative cycle.
+  return false;
+}
+
+// Picks a value in [lb, ub] outside the sorted set 'excl', as close to
+// 'pref' as possible.  Returns false if there is none.
+bool PickValue(wide_t lb, wide_t ub, wide_t pref,
+               const vector<wide_t>& excl, wide_t* val) {
+  wide_t start = std::min(std::max(pref, lb), ub);
+  wide_t limit = static_cast<wide_t>(excl.size()) + 1;
+  for (wide_t d = 0; d <= limit; d++) {
+    wide_t c[2] = { start + d, start - d };
+    for (int k = 0; k < 2; k++) {
+      if ((c[k] >= lb) && (c[k] <= ub)
+          && !std::binary_search(excl.begin(), excl.end(), c[k])) {
+        *val = c[k];
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+
+FastSolver::Result FastSolver::Solve(const vector<value_t>& old_soln,
+                                     const map<var_t,type_t>& vars,
+                                     const vector<const SymbolicPred*>& constraints,
+                                     map<var_t,value_t>* soln) {
+  if ((vars.size() > kMaxVars) || (constraints.size() > kMaxConstraints))
+    return UNKNOWN;
+
+  // Number the variables and add their type bounds.
+  const size_t n = vars.size();
+  map<var_t,size_t> idx;
+  vector<var_t> var_of(n);
+  DiffSystem sys(n);
+  for (VarIt i = vars.begin(); i != vars.end(); ++i) {
+    size_t x = idx.size();
+    idx[i->first] = x;
+    var_of[x] = i->first;
+    sys.AddLower(x, kMinValue[i->second]);
+    sys.AddUpper(x, kMaxValue[i->second]);
+  }
+
+  vector< vector<wide_t> > excl(n);
+  vector<bool> has_diff(n, false);
+  bool complete = true;
+
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    const SymbolicExpr& e = (*i)->expr();
+    const compare_op_t op = (*i)->op();
+    const wide_t c = e.const_term();
+
+    if (e.terms().size() == 1) {
+      // a*x + c op 0, i.e. a*x op -c.
+      size_t x = idx[e.terms().begin()->first];
+      wide_t a = e.terms().begin()->second;
+      wide_t lo = -kInfinity, hi = kInfinity;  // bounds on a*x
+      switch (op) {
+        case ops::EQ:  lo = hi = -c; break;
+        case ops::NEQ:
+          if ((-c) % a == 0)
+            excl[x].push_back(-c / a);
+          continue;
+        case ops::GT:  lo = -c + 1; break;
+        case ops::GE:  lo = -c; break;
+        case ops::LT:  hi = -c - 1; break;
+        case ops::LE:  hi = -c; break;
+      }
+      if ((op == ops::EQ) && ((-c) % a != 0))
+        return UNSAT;
+      if (lo > -kInfinity) {
+        if (a > 0) sys.AddLower(x, CeilDiv(lo, a));
+        else       sys.AddUpper(x, FloorDiv(lo, a));
+      }
+      if (hi < kInfinity) {
+        if (a > 0) sys.AddUpper(x, FloorDiv(hi, a));
+        else       sys.AddLower(x, CeilDiv(hi, a));
+      }
+
+    } else if (e.terms().size() == 2) {
+      SymbolicExpr::TermIt t = e.terms().begin();
+      SymbolicExpr::TermIt u = t;
+      ++u;
+      if (!(((t->second == 1) && (u->second == -1))
+            || ((t->second == -1) && (u->second == 1)))) {
+        complete = false;
+        continue;
+      }
+      // x_p - x_q + c op 0.
+      size_t p = idx[(t->second == 1) ? t->first : u->first];
+      size_t q = idx[(t->second == 1) ? u->first : t->first];
+      switch (op) {
+        case ops::EQ:  sys.AddDiff(p, q, -c); sys.AddDiff(q, p, c); break;
+        case ops::NEQ: break;  // Left to the final check.
+        case ops::GT:  sys.AddDiff(q, p, c - 1); break;
+        case ops::GE:  sys.AddDiff(q, p, c); break;
+        case ops::LT:  sys.AddDiff(p, q, -c - 1); break;
+        case ops::LE:  sys.AddDiff(p, q, -c); break;
+      }
+      has_diff[p] = has_diff[q] = true;
+
+    } else if (e.terms().empty()) {
+      map<var_t,value_t> none;
+      if (!(*i)->IsSatisfiedBy(none))
+        return UNSAT;
+
+    } else {
+      complete = false;
+    }
+  }
+
+  vector<wide_t> lb, ub;
+  if (!sys.Ranges(&lb, &ub))
+    return UNSAT;
+
+  for (size_t x = 0; x < n; x++) {
+    sort(excl[x].begin(), excl[x].end());
+    excl[x].erase(unique(excl[x].begin(), excl[x].end()), excl[x].end());
+    // Every value in the (exact) range is excluded.
+    wide_t dummy;
+    if (!PickValue(lb[x], ub[x], lb[x], excl[x], &dummy)
+        && (ub[x] - lb[x] + 1 <= static_cast<wide_t>(excl[x].size())))
+      return UNSAT;
+  }
+
+  if (!complete)
+    return UNKNOWN;
+
+  // Fix the variables one at a time.  For a consistent difference system
+  // any value in a variable's range extends to a full solution.
+  soln->clear();
+  for (size_t x = 0; x < n; x++) {
+    wide_t val;
+    if (!PickValue(lb[x], ub[x], old_soln[var_of[x]], excl[x], &val))
+      return UNKNOWN;
+    soln->insert(soln->end(), make_pair(var_of[x], static_cast<value_t>(val)));
+    if (has_diff[x]) {
+      sys.AddLower(x, val);
+      sys.AddUpper(x, val);
+      if (!sys.Ranges(&lb, &ub))
+        return UNKNOWN;
+    }
+  }
+
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    if (!(*i)->IsSatisfiedBy(*soln))
+      return UNKNOWN;
+  }
+  return SAT;
+}
+
+}  // namespace crest
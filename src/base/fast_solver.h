@@ -0,0 +1,52 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_FAST_SOLVER_H__
+#define BASE_FAST_SOLVER_H__
+
+#include <map>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_predicate.h"
+
+using std::map;
+using std::vector;
+
+namespace crest {
+
+// A solver for the common, trivial queries: constraints over one variable
+// (a*x + c op 0) and unit difference constraints (x - y + c op 0), plus
+// the variables' type bounds.
+//
+// The equalities and inequalities form a difference-constraint system,
+// which is checked for consistency by shortest paths (Bellman-Ford) and
+// yields the exact range of each variable.  Variables are then fixed one
+// at a time, preferring their previous value, while avoiding the values
+// excluded by single-variable disequalities.  Every answer is verified
+// concretely against all constraints.
+//
+// Anything else -- more variables per constraint, other coefficients,
+// two-variable disequalities that the greedy choice violates, too large
+// a query -- is UNKNOWN and left to Yices.  UNSAT is still reported when
+// the supported constraints alone are unsatisfiable.
+class FastSolver {
+ public:
+  enum Result { SAT, UNSAT, UNKNOWN };
+
+  static Result Solve(const vector<value_t>& old_soln,
+                      const map<var_t,type_t>& vars,
+                      const vector<const SymbolicPred*>& constraints,
+                      map<var_t,value_t>* soln);
+};
+
+}  // namespace crest
+
+#endif  // BASE_FAST_SOLVER_H__
@@ -0,0 +1,184 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <utility>
+
+#include "base/query_log.h"
+
+using std::ios;
+using std::istringstream;
+using std::make_pair;
+
+namespace crest {
+
+namespace {
+
+template <typename T>
+void Put(string* s, const T& x) {
+  s->append((const char*)&x, sizeof(x));
+}
+
+template <typename T>
+bool Get(istream& s, T* x) {
+  s.read((char*)x, sizeof(*x));
+  return !s.fail();
+}
+
+// True if 's' has at least 'n' more bytes, or is not seekable.
+bool HasBytes(istream& s, uint32_t n) {
+  istream::pos_type pos = s.tellg();
+  if (pos == istream::pos_type(-1))
+    return true;
+  s.seekg(0, ios::end);
+  istream::pos_type end = s.tellg();
+  s.seekg(pos);
+  return (end - pos) >= static_cast<std::streamoff>(n);
+}
+
+}  // namespace
+
+
+LoggedQuery::LoggedQuery()
+  : sat_(false), tier_(tiers::INDEPENDENT), secs_(0.0) { }
+
+LoggedQuery::~LoggedQuery() {
+  Clear();
+}
+
+void LoggedQuery::Clear() {
+  for (size_t i = 0; i < constraints_.size(); i++) {
+    delete constraints_[i];
+  }
+  constraints_.clear();
+  vars_.clear();
+  old_values_.clear();
+}
+
+bool LoggedQuery::Parse(istream& s) {
+  Clear();
+
+  // Read the whole record first, so that a bad length cannot make the
+  // fields run into the next record or past the end of the log.
+  uint32_t len;
+  if (!Get(s, &len) || !HasBytes(s, len))
+    return false;
+  string record(len, '\0');
+  if ((len > 0) && !s.read(&record[0], len))
+    return false;
+  istringstream in(record);
+
+  uint32_t num_vars, num_constraints;
+  if (!Get(in, &num_vars))
+    return false;
+  for (uint32_t i = 0; i < num_vars; i++) {
+    var_t v;
+    value_t val;
+    int type = in.get();
+    if ((type < types::U_CHAR) || (type > types::LONG_LONG)
+        || !Get(in, &v) || !Get(in, &val))
+      return false;
+    vars_.insert(vars_.end(), make_pair(v, static_cast<type_t>(type)));
+    old_values_.insert(old_values_.end(), make_pair(v, val));
+  }
+  if (!Get(in, &num_constraints))
+    return false;
+  for (uint32_t i = 0; i < num_constraints; i++) {
+    SymbolicPred* pred = new SymbolicPred();
+    constraints_.push_back(pred);
+    if (!pred->Parse(in))
+      return false;
+  }
+  sat_ = (in.get() != 0);
+  tier_ = static_cast<tier_t>(in.get());
+  // The fields must fill the record exactly.
+  return Get(in, &secs_) && (in.peek() == EOF);
+}
+
+void LoggedQuery::OldSolution(vector<value_t>* old_soln) const {
+  old_soln->clear();
+  if (vars_.empty())
+    return;
+  old_soln->resize(vars_.rbegin()->first + 1, 0);
+  typedef map<var_t,value_t>::const_iterator ValIt;
+  for (ValIt i = old_values_.begin(); i != old_values_.end(); ++i) {
+    (*old_soln)[i->first] = i->second;
+  }
+}
+
+
+QueryLog::QueryLog() : fd_(-1) { }
+
+QueryLog::~QueryLog() {
+  if (fd_ != -1)
+    close(fd_);
+}
+
+bool QueryLog::Open(const string& file) {
+  if (fd_ != -1)
+    close(fd_);
+  fd_ = open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd_ == -1) {
+    perror(file.c_str());
+    return false;
+  }
+  return true;
+}
+
+void QueryLog::Append(const vector<value_t>& old_soln,
+                      const map<var_t,type_t>& vars,
+                      const vector<const SymbolicPred*>& constraints,
+                      bool sat, tier_t tier, double secs) {
+  if (fd_ == -1)
+    return;
+
+  buf_.clear();
+  Put(&buf_, static_cast<uint32_t>(0));  // length, filled in below
+  Put(&buf_, static_cast<uint32_t>(vars.size()));
+  for (map<var_t,type_t>::const_iterator i = vars.begin(); i != vars.end(); ++i) {
+    value_t val = (i->first < old_soln.size()) ? old_soln[i->first] : 0;
+    buf_.push_back(static_cast<char>(i->second));
+    Put(&buf_, i->first);
+    Put(&buf_, val);
+  }
+  Put(&buf_, static_cast<uint32_t>(constraints.size()));
+  for (size_t i = 0; i < constraints.size(); i++) {
+    constraints[i]->Serialize(&buf_);
+  }
+  buf_.push_back(sat ? 1 : 0);
+  buf_.push_back(static_cast<char>(tier));
+  Put(&buf_, secs);
+
+  uint32_t len = buf_.size() - sizeof(uint32_t);
+  buf_.replace(0, sizeof(len), (const char*)&len, sizeof(len));
+
+  const char* p = buf_.data();
+  size_t n = buf_.size();
+  while (n > 0) {
+    ssize_t k = write(fd_, p, n);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0) {
+      perror("query log");
+      close(fd_);
+      fd_ = -1;
+      return;
+    }
+    p += k;
+    n -= k;
+  }
+}
+
+}  // namespace crest
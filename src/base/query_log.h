@@ -0,0 +1,105 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_QUERY_LOG_H__
+#define BASE_QUERY_LOG_H__
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_predicate.h"
+
+using std::istream;
+using std::map;
+using std::string;
+using std::vector;
+
+namespace crest {
+
+// Which part of the solver answered a query.
+namespace tiers {
+enum tier_t { CACHE = 0, FAST = 1, SESSION = 2, INDEPENDENT = 3, TIMEOUT = 4 };
+}  // namespace tiers
+
+using tiers::tier_t;
+
+// One recorded solver query: the (sliced) variables with their types and
+// previous values, the constraints (the last one negated), the answer,
+// the tier that gave it, and the wall-clock time taken.
+class LoggedQuery {
+ public:
+  LoggedQuery();
+  ~LoggedQuery();
+
+  // Reads the next record of a query log.  Returns false at the end of
+  // the log, or on a truncated or malformed record (e.g. one whose length
+  // runs past the end of the log, or disagrees with its contents).
+  bool Parse(istream& s);
+
+  // The previous values as an input vector indexed by variable (zero for
+  // variables outside the query), as the solver expects them.
+  void OldSolution(vector<value_t>* old_soln) const;
+
+  const map<var_t,type_t>& vars() const { return vars_; }
+  const map<var_t,value_t>& old_values() const { return old_values_; }
+  const vector<const SymbolicPred*>& constraints() const { return constraints_; }
+  bool sat() const { return sat_; }
+  tier_t tier() const { return tier_; }
+  double secs() const { return secs_; }
+
+ private:
+  void Clear();
+
+  map<var_t,type_t> vars_;
+  map<var_t,value_t> old_values_;
+  vector<const SymbolicPred*> constraints_;  // owned
+  bool sat_;
+  tier_t tier_;
+  double secs_;
+
+  // Not copyable.
+  LoggedQuery(const LoggedQuery&);
+  void operator=(const LoggedQuery&);
+};
+
+// Appends solver queries to a compact binary file (a query corpus), for
+// replay by tools/bench_solver.  Each record is written with a single
+// write() on a file opened for appending, so solver workers forked from
+// the same process can share the log.
+//
+// A record is its length (a uint32), followed by: the number of
+// variables (a uint32); for each, its type (one byte), the variable, and
+// its previous value; the number of constraints (a uint32) and each
+// constraint in SymbolicPred::Serialize format; the answer (one byte);
+// the tier (one byte); and the seconds taken (a double).
+class QueryLog {
+ public:
+  QueryLog();
+  ~QueryLog();
+
+  // Opens 'file' for appending, creating it if needed.
+  bool Open(const string& file);
+
+  void Append(const vector<value_t>& old_soln,
+              const map<var_t,type_t>& vars,
+              const vector<const SymbolicPred*>& constraints,
+              bool sat, tier_t tier, double secs);
+
+ private:
+  int fd_;
+  string buf_;
+};
+
+}  // namespace crest
+
+#endif  // BASE_QUERY_LOG_H__
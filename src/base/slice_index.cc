@@ -0,0 +1,136 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+
+#include "base/slice_index.h"
+
+namespace crest {
+
+namespace {
+const size_t kNever = std::numeric_limits<size_t>::max();
+}
+
+const var_t SliceIndex::kNoVar;
+
+SliceIndex::SliceIndex() { }
+
+SliceIndex::~SliceIndex() { }
+
+void SliceIndex::Clear() {
+  parent_.clear();
+  link_time_.clear();
+  rank_.clear();
+  rep_.clear();
+  group_of_.clear();
+  group_begin_.clear();
+  group_members_.clear();
+}
+
+void SliceIndex::Swap(SliceIndex& si) {
+  parent_.swap(si.parent_);
+  link_time_.swap(si.link_time_);
+  rank_.swap(si.rank_);
+  rep_.swap(si.rep_);
+  group_of_.swap(si.group_of_);
+  group_begin_.swap(si.group_begin_);
+  group_members_.swap(si.group_members_);
+}
+
+var_t SliceIndex::Find(var_t v, size_t time) const {
+  while (link_time_[v] <= time)
+    v = parent_[v];
+  return v;
+}
+
+void SliceIndex::Build(const vector<SymbolicPred*>& constraints,
+                       size_t num_vars) {
+  Clear();
+  parent_.resize(num_vars);
+  link_time_.resize(num_vars, kNever);
+  rank_.resize(num_vars, 0);
+  for (size_t v = 0; v < num_vars; v++)
+    parent_[v] = v;
+
+  // Union the variables of each constraint, stamped with its index.
+  rep_.resize(constraints.size(), kNoVar);
+  for (size_t i = 0; i < constraints.size(); i++) {
+    const SymbolicExpr::TermIt end = constraints[i]->expr().terms().end();
+    SymbolicExpr::TermIt j = constraints[i]->expr().terms().begin();
+    if (j == end)
+      continue;
+    assert(j->first < num_vars);
+    rep_[i] = j->first;
+    var_t root = Find(j->first, i);
+    for (++j; j != end; ++j) {
+      assert(j->first < num_vars);
+      var_t r = Find(j->first, i);
+      if (r == root)
+        continue;
+      if (rank_[r] > rank_[root])
+        std::swap(r, root);
+      parent_[r] = root;
+      link_time_[r] = i;
+      if (rank_[r] == rank_[root])
+        rank_[root]++;
+    }
+  }
+
+  // Group the constraints by final component (counting sort on the
+  // component's root, which keeps each group in path order).
+  vector<size_t> group_of_root(num_vars, kNever);
+  group_of_.resize(constraints.size());
+  vector<size_t> counts;
+  for (size_t i = 0; i < constraints.size(); i++) {
+    size_t g;
+    if (rep_[i] == kNoVar) {
+      g = counts.size();
+    } else {
+      var_t r = Find(rep_[i], kNever - 1);
+      if (group_of_root[r] == kNever)
+        group_of_root[r] = counts.size();
+      g = group_of_root[r];
+    }
+    if (g == counts.size())
+      counts.push_back(0);
+    counts[g]++;
+    group_of_[i] = g;
+  }
+
+  group_begin_.resize(counts.size() + 1, 0);
+  for (size_t g = 0; g < counts.size(); g++)
+    group_begin_[g+1] = group_begin_[g] + counts[g];
+  group_members_.resize(constraints.size());
+  vector<size_t> next(group_begin_.begin(), group_begin_.end() - 1);
+  for (size_t i = 0; i < constraints.size(); i++)
+    group_members_[next[group_of_[i]]++] = i;
+}
+
+void SliceIndex::Slice(size_t i, vector<size_t>* idxs) const {
+  assert(i < rep_.size());
+  if (rep_[i] == kNoVar) {
+    idxs->push_back(i);
+    return;
+  }
+
+  var_t root = Find(rep_[i], i);
+  size_t g = group_of_[i];
+  for (size_t k = group_begin_[g]; k < group_begin_[g+1]; k++) {
+    size_t j = group_members_[k];
+    if (j > i)
+      break;
+    if (Find(rep_[j], i) == root)
+      idxs->push_back(j);
+  }
+}
+
+}  // namespace crest
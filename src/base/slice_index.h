@@ -0,0 +1,68 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_SLICE_INDEX_H__
+#define BASE_SLICE_INDEX_H__
+
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_predicate.h"
+
+using std::vector;
+
+namespace crest {
+
+// Answers "which of the first i+1 path constraints are (transitively)
+// dependent on constraint i?" without rebuilding a dependence graph.
+//
+// Variables are kept in a union-find that records, for every link, the
+// index of the constraint that created it (no path compression, union by
+// rank), so the partition after any prefix of the path can be queried.
+// Constraints are also grouped by their component at the end of the
+// path; since components only grow, the slice for a prefix is a subset
+// of one such group.
+class SliceIndex {
+ public:
+  SliceIndex();
+  ~SliceIndex();
+
+  void Build(const vector<SymbolicPred*>& constraints, size_t num_vars);
+  void Clear();
+  void Swap(SliceIndex& si);
+
+  bool empty() const { return rep_.empty(); }
+
+  // Appends to 'idxs', in path order, the indices j <= i of the
+  // constraints that share a component with constraint i once
+  // constraints 0..i have been added.
+  void Slice(size_t i, vector<size_t>* idxs) const;
+
+ private:
+  static const var_t kNoVar = static_cast<var_t>(-1);
+
+  var_t Find(var_t v, size_t time) const;
+
+  vector<var_t> parent_;
+  vector<size_t> link_time_;  // when the link to 'parent_' was made
+  vector<unsigned char> rank_;
+
+  // A variable of each constraint (kNoVar if it has none).
+  vector<var_t> rep_;
+
+  // Constraint indices grouped by final component, in path order.
+  vector<size_t> group_of_;
+  vector<size_t> group_begin_;
+  vector<size_t> group_members_;
+};
+
+}  // namespace crest
+
+#endif  // BASE_SLICE_INDEX_H__
@@ -0,0 +1,468 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#include "base/solver_cache.h"
+
+using std::includes;
+using std::make_pair;
+using std::sort;
+using std::ifstream;
+using std::unique;
+
+namespace crest {
+
+namespace {
+
+// Bounds on the memory used by the cache.  When a table fills up, it is
+// simply cleared.
+const size_t kMaxExactEntries = 1 << 16;
+const size_t kMaxUnsatEntries = 1 << 14;
+const size_t kMaxModels = 16;
+
+typedef vector<const SymbolicPred*>::const_iterator PredIt;
+typedef map<var_t,type_t>::const_iterator VarIt;
+
+// Hashes the contents of 'file' into 'h'.  Returns false if the file
+// cannot be read.
+bool HashFile(const string& file, hash_t* h) {
+  ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+  if (!in)
+    return false;
+  char buff[1 << 16];
+  while (in.read(buff, sizeof(buff)) || in.gcount()) {
+    for (std::streamsize i = 0; i < in.gcount(); i++) {
+      *h = (*h ^ static_cast<unsigned char>(buff[i])) * 1099511628211ULL;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+
+// An open-addressing hash table of solver results in a shared,
+// memory-mapped file.  The file is a header, an array of slots, and an
+// append-only area of records.
+//
+// Writers serialize on flock() and write a record, then advance the
+// header's free offset, then publish the record by storing its offset and
+// then its (non-zero) hash into a free slot.  A writer killed part way
+// thus leaves at most unreferenced bytes.  Readers take no lock: they see
+// either an empty slot or a fully written record.
+//
+// flock() locks belong to an open file description, which a fork()ed
+// child (a solver pool worker, or a timed solve) shares with its parent,
+// so each process locks through a descriptor it opened itself.
+class PersistentTable {
+ public:
+  PersistentTable() : fd_(-1), owner_(0), base_(NULL), size_(0) { }
+  ~PersistentTable();
+
+  bool Open(const string& path);
+  bool Find(hash_t h, const SolverCache::Key& key,
+            bool* sat, map<var_t,value_t>* soln) const;
+  void Insert(hash_t h, const SolverCache::Key& key,
+              bool sat, const map<var_t,value_t>& soln);
+
+ private:
+  struct Header {
+    char magic[8];
+    uint64_t num_slots;
+    uint64_t data_begin;
+    uint64_t data_end;
+    uint64_t data_used;  // offset of the first free byte
+  };
+
+  struct Slot {
+    uint64_t hash;
+    uint64_t offset;
+  };
+
+  struct Record {
+    uint32_t key_size;
+    uint32_t num_vals;
+    uint32_t sat;
+    uint32_t pad;
+    // Followed by key_size hashes and num_vals (var, value) pairs.
+  };
+
+  static const uint64_t kNumSlots = 1 << 20;
+  static const uint64_t kDataSize = 1 << 28;
+
+  Header* header() const { return reinterpret_cast<Header*>(base_); }
+  Slot* slots() const { return reinterpret_cast<Slot*>(base_ + sizeof(Header)); }
+  bool Matches(uint64_t offset, const SolverCache::Key& key) const;
+
+  // Reopens the file if this process did not open fd_ itself.
+  bool OwnDescriptor();
+
+  string path_;
+  int fd_;
+  pid_t owner_;
+  char* base_;
+  size_t size_;
+};
+
+namespace {
+const char kMagic[8] = { 'C', 'R', 'S', 'T', 'S', 'C', 'H', '1' };
+}
+
+PersistentTable::~PersistentTable() {
+  if (base_)
+    munmap(base_, size_);
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool PersistentTable::Open(const string& path) {
+  path_ = path;
+  owner_ = getpid();
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd_ < 0)
+    return false;
+
+  uint64_t data_begin = sizeof(Header) + kNumSlots * sizeof(Slot);
+  size_ = data_begin + kDataSize;
+
+  // The first process to get here initializes the file.  The file is
+  // sparse, so unused space costs nothing on disk.
+  flock(fd_, LOCK_EX);
+  struct stat st;
+  bool ok = (fstat(fd_, &st) == 0);
+  if (ok && (st.st_size == 0)) {
+    Header h;
+    memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.num_slots = kNumSlots;
+    h.data_begin = data_begin;
+    h.data_end = size_;
+    h.data_used = data_begin;
+    ok = (ftruncate(fd_, size_) == 0)
+      && (pwrite(fd_, &h, sizeof(h), 0) == static_cast<ssize_t>(sizeof(h)));
+  } else if (ok) {
+    ok = (static_cast<size_t>(st.st_size) == size_);
+  }
+  flock(fd_, LOCK_UN);
+  if (!ok)
+    return false;
+
+  void* p = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED)
+    return false;
+  base_ = static_cast<char*>(p);
+
+  Header* h = header();
+  if (memcmp(h->magic, kMagic, sizeof(kMagic))
+      || (h->num_slots != kNumSlots) || (h->data_begin != data_begin)
+      || (h->data_end != size_)) {
+    munmap(base_, size_);
+    base_ = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool PersistentTable::OwnDescriptor() {
+  if (owner_ == getpid())
+    return true;
+  // Closing the inherited descriptor leaves the parent's lock alone: the
+  // parent still holds the description open.
+  close(fd_);
+  owner_ = getpid();
+  fd_ = open(path_.c_str(), O_RDWR);
+  return (fd_ >= 0);
+}
+
+bool PersistentTable::Matches(uint64_t offset, const SolverCache::Key& key) const {
+  const Record* r = reinterpret_cast<const Record*>(base_ + offset);
+  if (r->key_size != key.size())
+    return false;
+  return !memcmp(r + 1, &key.front(), key.size() * sizeof(hash_t));
+}
+
+bool PersistentTable::Find(hash_t h, const SolverCache::Key& key,
+                           bool* sat, map<var_t,value_t>* soln) const {
+  if (key.empty())
+    return false;
+  if (h == 0)
+    h = 1;
+
+  Slot* s = slots();
+  uint64_t mask = kNumSlots - 1;
+  for (uint64_t i = h & mask, n = 0; n < kNumSlots; i = (i + 1) & mask, n++) {
+    uint64_t sh = __atomic_load_n(&s[i].hash, __ATOMIC_ACQUIRE);
+    if (sh == 0)
+      return false;
+    if (sh != h)
+      continue;
+    uint64_t offset = __atomic_load_n(&s[i].offset, __ATOMIC_ACQUIRE);
+    if (!Matches(offset, key))
+      continue;
+
+    const Record* r = reinterpret_cast<const Record*>(base_ + offset);
+    const char* p = reinterpret_cast<const char*>(r + 1) + r->key_size * sizeof(hash_t);
+    *sat = (r->sat != 0);
+    soln->clear();
+    for (uint32_t j = 0; j < r->num_vals; j++) {
+      uint64_t var;
+      value_t val;
+      memcpy(&var, p, sizeof(var));
+      memcpy(&val, p + sizeof(var), sizeof(val));
+      p += sizeof(var) + sizeof(val);
+      soln->insert(soln->end(), std::make_pair(static_cast<var_t>(var), val));
+    }
+    return true;
+  }
+  return false;
+}
+
+void PersistentTable::Insert(hash_t h, const SolverCache::Key& key,
+                             bool sat, const map<var_t,value_t>& soln) {
+  if (key.empty())
+    return;
+  if (h == 0)
+    h = 1;
+
+  uint64_t bytes = sizeof(Record) + key.size() * sizeof(hash_t)
+    + soln.size() * (sizeof(uint64_t) + sizeof(value_t));
+  bytes = (bytes + 7) & ~static_cast<uint64_t>(7);
+
+  if (!OwnDescriptor() || (flock(fd_, LOCK_EX) != 0))
+    return;
+  Header* hd = header();
+  Slot* s = slots();
+  uint64_t mask = kNumSlots - 1;
+  uint64_t i = h & mask, n = 0;
+  for (; n < kNumSlots / 2; i = (i + 1) & mask, n++) {
+    if (s[i].hash == 0)
+      break;
+    if ((s[i].hash == h) && Matches(s[i].offset, key))
+      break;
+  }
+
+  // Give up silently when the table is (too) full or the key is present.
+  if ((n < kNumSlots / 2) && (s[i].hash == 0)
+      && (hd->data_used + bytes <= hd->data_end)) {
+    uint64_t offset = hd->data_used;
+    Record* r = reinterpret_cast<Record*>(base_ + offset);
+    r->key_size = key.size();
+    r->num_vals = soln.size();
+    r->sat = sat;
+    r->pad = 0;
+    char* p = reinterpret_cast<char*>(r + 1);
+    memcpy(p, &key.front(), key.size() * sizeof(hash_t));
+    p += key.size() * sizeof(hash_t);
+    for (map<var_t,value_t>::const_iterator j = soln.begin(); j != soln.end(); ++j) {
+      uint64_t var = j->first;
+      memcpy(p, &var, sizeof(var));
+      memcpy(p + sizeof(var), &j->second, sizeof(j->second));
+      p += sizeof(var) + sizeof(j->second);
+    }
+    __atomic_store_n(&hd->data_used, offset + bytes, __ATOMIC_RELEASE);
+    __atomic_store_n(&s[i].offset, offset, __ATOMIC_RELEASE);
+    __atomic_store_n(&s[i].hash, h, __ATOMIC_RELEASE);
+  }
+  flock(fd_, LOCK_UN);
+}
+
+
+SolverCache::SolverCache() : persistent_(NULL) { }
+
+SolverCache::~SolverCache() {
+  delete persistent_;
+}
+
+
+bool SolverCache::OpenPersistent(const string& dir, const string& program,
+                                 const string& variant) {
+  // Identify the program by its binary (the first word of the command)
+  // and by its instrumentation.
+  hash_t id = 14695981039346656037ULL;
+  string binary = program.substr(0, program.find_first_of(" \t"));
+  if (!HashFile(binary, &id) || !HashFile("branches", &id)) {
+    fprintf(stderr, "Solver cache: cannot identify program '%s'.\n", binary.c_str());
+    return false;
+  }
+  for (size_t i = 0; i < variant.size(); i++)
+    id = (id ^ static_cast<unsigned char>(variant[i])) * 1099511628211ULL;
+
+  if ((mkdir(dir.c_str(), 0777) != 0) && (errno != EEXIST)) {
+    fprintf(stderr, "Solver cache: cannot create %s.\n", dir.c_str());
+    return false;
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.cache", id);
+  string path = dir + name;
+  PersistentTable* table = new PersistentTable();
+  if (!table->Open(path)) {
+    fprintf(stderr, "Solver cache: cannot use %s.\n", path.c_str());
+    delete table;
+    return false;
+  }
+
+  delete persistent_;
+  persistent_ = table;
+  return true;
+}
+
+
+void SolverCache::MakeKey(const map<var_t,type_t>& vars,
+                          const vector<const SymbolicPred*>& constraints,
+                          Key* key) {
+  key->clear();
+  key->reserve(vars.size() + constraints.size());
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    key->push_back((*i)->Hash());
+  }
+  // The type bounds of the variables are part of the query.
+  for (VarIt i = vars.begin(); i != vars.end(); ++i) {
+    hash_t h = (static_cast<hash_t>(i->first) << 8) | static_cast<hash_t>(i->second);
+    key->push_back((h ^ 0x9e3779b97f4a7c15ULL) * 1099511628211ULL);
+  }
+  sort(key->begin(), key->end());
+  key->erase(unique(key->begin(), key->end()), key->end());
+}
+
+
+hash_t SolverCache::HashKey(const Key& key) {
+  hash_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.size(); i++) {
+    h = (h ^ key[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+
+bool SolverCache::HasUnsatSubset(const Key& key) const {
+  // Any unsatisfiable subset of 'key' is indexed by one of its elements.
+  for (size_t i = 0; i < key.size(); i++) {
+    map<hash_t, vector<size_t> >::const_iterator it = unsat_index_.find(key[i]);
+    if (it == unsat_index_.end())
+      continue;
+    const vector<size_t>& ids = it->second;
+    for (size_t j = 0; j < ids.size(); j++) {
+      const Key& s = unsat_[ids[j]];
+      if ((s.size() <= key.size() - i)
+          && includes(key.begin() + i, key.end(), s.begin(), s.end()))
+        return true;
+    }
+  }
+  return false;
+}
+
+
+bool SolverCache::TryModel(const map<var_t,value_t>& model,
+                           const vector<value_t>& old_soln,
+                           const map<var_t,type_t>& vars,
+                           const vector<const SymbolicPred*>& constraints,
+                           map<var_t,value_t>* soln) const {
+  soln->clear();
+  for (VarIt i = vars.begin(); i != vars.end(); ++i) {
+    map<var_t,value_t>::const_iterator m = model.find(i->first);
+    value_t val = (m != model.end()) ? m->second : old_soln[i->first];
+    if ((val < kMinValue[i->second]) || (val > kMaxValue[i->second]))
+      return false;
+    soln->insert(soln->end(), make_pair(i->first, val));
+  }
+
+  for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+    if (!(*i)->IsSatisfiedBy(*soln))
+      return false;
+  }
+  return true;
+}
+
+
+SolverCache::Result SolverCache::Lookup(const vector<value_t>& old_soln,
+                                        const map<var_t,type_t>& vars,
+                                        const vector<const SymbolicPred*>& constraints,
+                                        Key* key,
+                                        map<var_t,value_t>* soln,
+                                        bool* sat) {
+  MakeKey(vars, constraints, key);
+
+  hash_t h = HashKey(*key);
+  map<hash_t,Entry>::const_iterator it = exact_.find(h);
+  if ((it != exact_.end()) && (it->second.key == *key)) {
+    *sat = it->second.sat;
+    *soln = it->second.soln;
+    return EXACT_HIT;
+  }
+
+  if (persistent_ && persistent_->Find(h, *key, sat, soln)) {
+    if (exact_.size() >= kMaxExactEntries)
+      exact_.clear();
+    Entry& e = exact_[h];
+    e.key = *key;
+    e.sat = *sat;
+    e.soln = *soln;
+    return PERSISTENT_HIT;
+  }
+
+  if (HasUnsatSubset(*key)) {
+    *sat = false;
+    soln->clear();
+    return UNSAT_SUBSET_HIT;
+  }
+
+  for (size_t i = 0; i < models_.size(); i++) {
+    if (TryModel(models_[i], old_soln, vars, constraints, soln)) {
+      *sat = true;
+      return MODEL_HIT;
+    }
+  }
+
+  soln->clear();
+  return MISS;
+}
+
+
+void SolverCache::Insert(const Key& key, bool sat,
+                         const map<var_t,value_t>& soln) {
+  hash_t h = HashKey(key);
+  if (persistent_)
+    persistent_->Insert(h, key, sat, soln);
+
+  if (exact_.size() >= kMaxExactEntries)
+    exact_.clear();
+  Entry& e = exact_[h];
+  e.key = key;
+  e.sat = sat;
+  e.soln = soln;
+
+  if (sat) {
+    models_.push_front(soln);
+    if (models_.size() > kMaxModels)
+      models_.pop_back();
+  } else if (!key.empty()) {
+    if (unsat_.size() >= kMaxUnsatEntries) {
+      unsat_.clear();
+      unsat_index_.clear();
+    }
+    unsat_index_[key.front()].push_back(unsat_.size());
+    unsat_.push_back(key);
+  }
+}
+
+}  // namespace crest
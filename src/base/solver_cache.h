@@ -0,0 +1,108 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef BASE_SOLVER_CACHE_H__
+#define BASE_SOLVER_CACHE_H__
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_predicate.h"
+
+using std::deque;
+using std::map;
+using std::string;
+using std::vector;
+
+namespace crest {
+
+class PersistentTable;
+
+// Caches the results of (sliced) solver queries.
+//
+// A query is keyed by the sorted set of its predicate hashes, together
+// with the types of its variables.  Lookup tries, in order:
+//
+//  (1) an exact match on the key;
+//  (2) a known-unsatisfiable key that is a subset of the query's key
+//      (any superset of an unsatisfiable set is unsatisfiable);
+//  (3) a recently returned model, completed with the previous input and
+//      evaluated concretely against the query's constraints.
+//
+// The exact-match table can additionally be backed by a memory-mapped
+// file (see OpenPersistent), which is shared by every run_crest process
+// testing the same program -- e.g. the parallel workers of a tuning run.
+class SolverCache {
+ public:
+  typedef vector<hash_t> Key;
+
+  enum Result { MISS, EXACT_HIT, PERSISTENT_HIT, UNSAT_SUBSET_HIT, MODEL_HIT };
+
+  SolverCache();
+  ~SolverCache();
+
+  // Opens (creating if needed) the cache file in directory 'dir' for
+  // 'program', the command line given to run_crest.  The file name is
+  // derived from the contents of the program's binary and of the
+  // "branches" file in the current directory.  Returns false, leaving
+  // the cache in-memory only, if the file cannot be used.  A non-empty
+  // 'variant' (e.g. the solver's encoding) selects a separate file.
+  bool OpenPersistent(const string& dir, const string& program,
+                      const string& variant);
+
+  // Looks up the query over 'vars' and 'constraints'.  On a hit, sets
+  // '*sat' and, if satisfiable, stores values for 'vars' in 'soln'.
+  // Always sets 'key' for a following Insert.
+  Result Lookup(const vector<value_t>& old_soln,
+                const map<var_t,type_t>& vars,
+                const vector<const SymbolicPred*>& constraints,
+                Key* key,
+                map<var_t,value_t>* soln,
+                bool* sat);
+
+  // Records the solver's answer for the query with the given 'key'.
+  void Insert(const Key& key, bool sat, const map<var_t,value_t>& soln);
+
+ private:
+  struct Entry {
+    Key key;
+    bool sat;
+    map<var_t,value_t> soln;
+  };
+
+  static void MakeKey(const map<var_t,type_t>& vars,
+                      const vector<const SymbolicPred*>& constraints,
+                      Key* key);
+  static hash_t HashKey(const Key& key);
+
+  bool HasUnsatSubset(const Key& key) const;
+  bool TryModel(const map<var_t,value_t>& model,
+                const vector<value_t>& old_soln,
+                const map<var_t,type_t>& vars,
+                const vector<const SymbolicPred*>& constraints,
+                map<var_t,value_t>* soln) const;
+
+  map<hash_t,Entry> exact_;
+  PersistentTable* persistent_;
+
+  // Known-unsatisfiable keys, indexed by their smallest element.
+  vector<Key> unsat_;
+  map<hash_t, vector<size_t> > unsat_index_;
+
+  // The most recent satisfying models, newest first.
+  deque< map<var_t,value_t> > models_;
+};
+
+}  // namespace crest
+
+#endif  // BASE_SOLVER_CACHE_H__
@@ -8,6 +8,7 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
+#include <algorithm>
 #include <utility>
 
 #include "base/symbolic_execution.h"
@@ -25,6 +26,8 @@ void SymbolicExecution::Swap(SymbolicExecution& se) {
   vars_.swap(se.vars_);
   inputs_.swap(se.inputs_);
   path_.Swap(se.path_);
+  slices_.Swap(se.slices_);
+  first_occurrence_.swap(se.first_occurrence_);
 }
 
 void SymbolicExecution::Serialize(string* s) const {
@@ -53,8 +56,46 @@ bool SymbolicExecution::Parse(istream& s) {
     s.read((char*)&inputs_[i], sizeof(value_t));
   }
 
-  // Write the path.
-  return (path_.Parse(s) && !s.fail());
+  // Read the path.
+  if (!path_.Parse(s) || s.fail())
+    return false;
+
+  slices_.Build(path_.constraints(), len);
+  BuildFirstOccurrences();
+  return true;
+}
+
+void SymbolicExecution::BuildFirstOccurrences() {
+  const vector<SymbolicPred*>& constraints = path_.constraints();
+  const size_t n = constraints.size();
+
+  // Sort the constraints by hash (ties in path order), so that equal
+  // constraints end up in one run of equal hashes.
+  vector< std::pair<hash_t,size_t> > by_hash(n);
+  for (size_t i = 0; i < n; i++) {
+    by_hash[i] = std::make_pair(constraints[i]->Hash(), i);
+  }
+  std::sort(by_hash.begin(), by_hash.end());
+
+  first_occurrence_.resize(n);
+  for (size_t i = 0; i < n; ) {
+    size_t end = i + 1;
+    while ((end < n) && (by_hash[end].first == by_hash[i].first))
+      end++;
+    // Runs are short (usually one), so compare within them directly.
+    for (size_t j = i; j < end; j++) {
+      size_t cj = by_hash[j].second;
+      first_occurrence_[cj] = cj;
+      for (size_t k = i; k < j; k++) {
+        size_t ck = by_hash[k].second;
+        if (first_occurrence_[ck] == ck && constraints[cj]->Equal(*constraints[ck])) {
+          first_occurrence_[cj] = ck;
+          break;
+        }
+      }
+    }
+    i = end;
+  }
 }
 
 }  // namespace crest
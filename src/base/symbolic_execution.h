@@ -17,6 +17,7 @@
 #include <vector>
 
 #include "base/basic_types.h"
+#include "base/slice_index.h"
 #include "base/symbolic_path.h"
 
 using std::istream;
@@ -41,6 +42,16 @@ class SymbolicExecution {
   const vector<value_t>& inputs() const { return inputs_; }
   const SymbolicPath& path() const      { return path_; }
 
+  // Independence slices of the path constraints, built by Parse.
+  const SliceIndex& slices() const      { return slices_; }
+
+  // The index of the first path constraint Equal to the i-th one (i
+  // itself if there is none), built by Parse.
+  size_t first_occurrence(size_t i) const { return first_occurrence_[i]; }
+  bool has_first_occurrences() const {
+    return first_occurrence_.size() == path_.constraints().size();
+  }
+
   map<var_t,type_t>* mutable_vars() { return &vars_; }
   vector<value_t>* mutable_inputs() { return &inputs_; }
   SymbolicPath* mutable_path() { return &path_; }
@@ -49,6 +60,10 @@ class SymbolicExecution {
   map<var_t,type_t>  vars_;
   vector<value_t> inputs_;
   SymbolicPath path_;  
+  SliceIndex slices_;
+  vector<size_t> first_occurrence_;
+
+  void BuildFirstOccurrences();
 };
 
 }  // namespace crest
@@ -9,6 +9,7 @@
 // for details.
 
 #include <assert.h>
+#include <limits>
 #include <stdio.h>
 #include "base/symbolic_expression.h"
 
@@ -17,6 +18,10 @@ namespace crest {
 typedef map<var_t,value_t>::iterator It;
 typedef map<var_t,value_t>::const_iterator ConstIt;
 
+namespace {
+const value_t kMinValueT = std::numeric_limits<value_t>::min();
+}
+
 
 SymbolicExpr::~SymbolicExpr() { }
 
@@ -40,6 +45,45 @@ void SymbolicExpr::Negate() {
 }
 
 
+bool SymbolicExpr::CanNegate() const {
+  if (const_ == kMinValueT)
+    return false;
+  for (ConstIt i = coeff_.begin(); i != coeff_.end(); ++i) {
+    if (i->second == kMinValueT)
+      return false;
+  }
+  return true;
+}
+
+
+value_t SymbolicExpr::CoeffGcd() const {
+  typedef unsigned long long uvalue_t;
+  uvalue_t g = 0;
+  for (ConstIt i = coeff_.begin(); i != coeff_.end(); ++i) {
+    uvalue_t a = (i->second < 0) ? -static_cast<uvalue_t>(i->second) : i->second;
+    while (a != 0) {
+      uvalue_t t = g % a;
+      g = a;
+      a = t;
+    }
+  }
+  return (g > static_cast<uvalue_t>(std::numeric_limits<value_t>::max())) ? 0 : g;
+}
+
+
+void SymbolicExpr::DivideFloor(value_t d) {
+  assert(d > 0);
+  value_t q = const_ / d;
+  if ((const_ % d != 0) && (const_ < 0))
+    q--;
+  const_ = q;
+  for (It i = coeff_.begin(); i != coeff_.end(); ++i) {
+    assert(i->second % d == 0);
+    i->second /= d;
+  }
+}
+
+
 void SymbolicExpr::AppendVars(set<var_t>* vars) const {
   for (ConstIt i = coeff_.begin(); i != coeff_.end(); ++i) {
     vars->insert(i->first);
@@ -69,6 +113,47 @@ void SymbolicExpr::AppendToString(string* s) const {
 }
 
 
+namespace {
+
+// 64-bit FNV-1a.
+const hash_t kFnvOffsetBasis = 14695981039346656037ULL;
+const hash_t kFnvPrime = 1099511628211ULL;
+
+inline hash_t FnvAppend(hash_t h, const void* data, size_t n) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= kFnvPrime;
+  }
+  return h;
+}
+
+}  // namespace
+
+hash_t SymbolicExpr::Hash() const {
+  hash_t h = FnvAppend(kFnvOffsetBasis, &const_, sizeof(const_));
+  for (ConstIt i = coeff_.begin(); i != coeff_.end(); ++i) {
+    h = FnvAppend(h, &i->first, sizeof(i->first));
+    h = FnvAppend(h, &i->second, sizeof(i->second));
+  }
+  return h;
+}
+
+
+bool SymbolicExpr::Evaluate(const map<var_t,value_t>& assignment,
+                            value_t* result) const {
+  value_t sum = const_;
+  for (ConstIt i = coeff_.begin(); i != coeff_.end(); ++i) {
+    value_t prod;
+    if (__builtin_mul_overflow(i->second, assignment.find(i->first)->second, &prod)
+        || __builtin_add_overflow(sum, prod, &sum))
+      return false;
+  }
+  *result = sum;
+  return true;
+}
+
+
 void SymbolicExpr::Serialize(string* s) const {
   assert(coeff_.size() < 128);
   s->push_back(static_cast<char>(coeff_.size()));
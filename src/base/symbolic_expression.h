@@ -45,6 +45,8 @@ class SymbolicExpr {
   ~SymbolicExpr();
 
   void Negate();
+  // Returns false if negating would overflow (some value is the minimum).
+  bool CanNegate() const;
   bool IsConcrete() const { return coeff_.empty(); }
   size_t Size() const { return (1 + coeff_.size()); }
   void AppendVars(set<var_t>* vars) const;
@@ -63,6 +65,21 @@ class SymbolicExpr {
   const SymbolicExpr& operator*=(value_t c);
   bool operator==(const SymbolicExpr& e) const;
 
+  // Returns the (positive) greatest common divisor of the coefficients,
+  // or 0 if the expression is concrete or the divisor does not fit.
+  value_t CoeffGcd() const;
+
+  // Divides every coefficient by 'd' > 0, which must divide them all,
+  // and divides the constant term by 'd' rounding down.
+  void DivideFloor(value_t d);
+
+  // A 64-bit hash of the expression, stable across runs and processes.
+  hash_t Hash() const;
+
+  // Evaluates the expression under 'assignment', which must contain all
+  // of its variables.  Returns false if the evaluation overflows.
+  bool Evaluate(const map<var_t,value_t>& assignment, value_t* result) const;
+
   // Accessors.
   value_t const_term() const { return const_; }
   const map<var_t,value_t>& terms() const { return coeff_; }
@@ -30,14 +30,17 @@ using std::vector;
 namespace crest {
 
 typedef map<addr_t,SymbolicExpr*>::const_iterator ConstMemIt;
+typedef map<addr_t,SymbolicExpr*>::iterator MemIt;
 
 SymbolicInterpreter::SymbolicInterpreter()
-  : pred_(NULL), return_value_(false), ex_(true), num_inputs_(0) {
+  : pred_(NULL), return_value_(false), normalize_(true), ex_(true),
+    num_inputs_(0) {
   stack_.reserve(16);
 }
 
 SymbolicInterpreter::SymbolicInterpreter(const vector<value_t>& input)
-  : pred_(NULL), return_value_(false), ex_(true), num_inputs_(0) {
+  : pred_(NULL), return_value_(false), normalize_(true), ex_(true),
+    num_inputs_(0) {
   stack_.reserve(16);
   ex_.mutable_inputs()->assign(input.begin(), input.end());
 }
@@ -48,6 +51,21 @@ void SymbolicInterpreter::DumpMemory() {
     i->second->AppendToString(&s);
     fprintf(stderr, "%lu: %s [%d]\n", i->first, s.c_str(), *(int*)(i->first));
   }
+  typedef map<addr_t,ShadowRegion>::const_iterator ConstRegionIt;
+  for (ConstRegionIt i = regions_.begin(); i != regions_.end(); ++i) {
+    const ShadowRegion& r = i->second;
+    fprintf(stderr, "%lu-%lu: buffer of %zu x %zu bytes from x%u\n",
+            i->first, r.end, r.exprs.size(), r.elem_size, r.first_var);
+    for (size_t j = 0; j < r.exprs.size(); j++) {
+      if (!r.fresh[j] && r.exprs[j]) {
+        string s;
+        r.exprs[j]->AppendToString(&s);
+        fprintf(stderr, "  %lu: %s\n", i->first + j * r.elem_size, s.c_str());
+      } else if (!r.fresh[j]) {
+        fprintf(stderr, "  %lu: concrete\n", i->first + j * r.elem_size);
+      }
+    }
+  }
   for (size_t i = 0; i < stack_.size(); i++) {
     string s;
     if (stack_[i].expr) {
@@ -82,11 +100,23 @@ void SymbolicInterpreter::ClearStack(id_t id) {
 
 void SymbolicInterpreter::Load(id_t id, addr_t addr, value_t value) {
   IFDEBUG(fprintf(stderr, "load %lu %lld\n", addr, value));
-  ConstMemIt it = mem_.find(addr);
-  if (it == mem_.end()) {
-    PushConcrete(value);
+  size_t idx;
+  ShadowRegion* r = regions_.empty() ? NULL : FindRegion(addr, &idx);
+  if (r) {
+    if (r->fresh[idx]) {
+      PushSymbolic(new SymbolicExpr(1, r->first_var + idx), value);
+    } else if (r->exprs[idx]) {
+      PushSymbolic(new SymbolicExpr(*r->exprs[idx]), value);
+    } else {
+      PushConcrete(value);
+    }
   } else {
-    PushSymbolic(new SymbolicExpr(*it->second), value);
+    ConstMemIt it = mem_.find(addr);
+    if (it == mem_.end()) {
+      PushConcrete(value);
+    } else {
+      PushSymbolic(new SymbolicExpr(*it->second), value);
+    }
   }
   ClearPredicateRegister();
   IFDEBUG(DumpMemory());
@@ -98,7 +128,27 @@ void SymbolicInterpreter::Store(id_t id, addr_t addr) {
   assert(stack_.size() > 0);
 
   const StackElem& se = stack_.back();
-  if (se.expr) {
+  size_t idx;
+  ShadowRegion* r = regions_.empty() ? NULL : FindContainingRegion(addr, &idx);
+  if (r && (addr != r->start + idx * r->elem_size)) {
+    // A store into the middle of a buffer element (whose width we do not
+    // know) leaves that element concrete; the stored value is kept at
+    // 'addr' in the memory map, as for any other scalar.
+    delete r->exprs[idx];
+    r->exprs[idx] = NULL;
+    r->fresh[idx] = false;
+    r = NULL;
+  }
+  if (r) {
+    delete r->exprs[idx];
+    r->exprs[idx] = NULL;
+    r->fresh[idx] = false;
+    if (se.expr && !se.expr->IsConcrete()) {
+      r->exprs[idx] = se.expr;
+    } else {
+      delete se.expr;
+    }
+  } else if (se.expr) {
     if (!se.expr->IsConcrete()) {
       mem_[addr] = se.expr;
     } else {
@@ -180,8 +230,14 @@ void SymbolicInterpreter::ApplyBinaryOp(id_t id, binary_op_t op, value_t value)
 
     case ops::SHIFT_L:
       if (a.expr != NULL) {
-        // Convert to multiplication by a (concrete) constant.
-        *a.expr *= (1 << b.concrete);
+        if ((b.concrete >= 0) && (b.concrete < 8 * static_cast<value_t>(sizeof(value_t)))) {
+          // Convert to multiplication by a (concrete) constant.
+          *a.expr *= static_cast<value_t>(1ULL << b.concrete);
+        } else {
+          // Out-of-range shift: treat as a concrete operator.
+          delete a.expr;
+          a.expr = NULL;
+        }
       }
       delete b.expr;
       break;
@@ -236,6 +292,8 @@ void SymbolicInterpreter::ApplyCompareOp(id_t id, compare_op_t op, value_t value
     // store it in the predicate register.
     if (!a.expr->IsConcrete()) {
       pred_ = new SymbolicPred(op, a.expr);
+      if (normalize_)
+        pred_->Normalize();
     } else {
       ClearPredicateRegister();
       delete a.expr;
@@ -309,7 +367,21 @@ void SymbolicInterpreter::Branch(id_t id, branch_id_t bid, bool pred_value) {
 value_t SymbolicInterpreter::NewInput(type_t type, addr_t addr) {
   IFDEBUG(fprintf(stderr, "symbolic_input %d %lu\n", type, addr));
 
-  mem_[addr] = new SymbolicExpr(1, num_inputs_);
+  SymbolicExpr* expr = new SymbolicExpr(1, num_inputs_);
+  size_t idx;
+  ShadowRegion* r = regions_.empty() ? NULL : FindRegion(addr, &idx);
+  if (r && (r->elem_size == kByteSize[type])) {
+    // A new input exactly over a buffer element replaces it.
+    delete r->exprs[idx];
+    r->exprs[idx] = expr;
+    r->fresh[idx] = false;
+  } else {
+    // Otherwise any buffer (or older symbolic value) it overlaps is
+    // dissolved around it.
+    RemoveRegions(addr, addr + kByteSize[type]);
+    delete mem_[addr];
+    mem_[addr] = expr;
+  }
   ex_.mutable_vars()->insert(make_pair(num_inputs_ ,type));
 
   value_t ret = 0;
@@ -329,6 +401,99 @@ value_t SymbolicInterpreter::NewInput(type_t type, addr_t addr) {
 }
 
 
+var_t SymbolicInterpreter::NewInputBuffer(type_t type, addr_t addr, size_t n,
+                                          const value_t* initial) {
+  IFDEBUG(fprintf(stderr, "symbolic_buffer %d %lu %zu\n", type, addr, n));
+
+  const var_t first = num_inputs_;
+  if (n == 0)
+    return first;
+
+  const size_t elem_size = kByteSize[type];
+  RemoveRegions(addr, addr + n * elem_size);
+
+  ShadowRegion& r = regions_[addr];
+  r.start = addr;
+  r.end = addr + n * elem_size;
+  r.elem_size = elem_size;
+  r.first_var = first;
+  r.exprs.assign(n, NULL);
+  r.fresh.assign(n, true);
+
+  // Variables are numbered consecutively, so each one goes at the end.
+  map<var_t,type_t>* vars = ex_.mutable_vars();
+  vector<value_t>* inputs = ex_.mutable_inputs();
+  for (size_t i = 0; i < n; i++) {
+    vars->insert(vars->end(), make_pair(num_inputs_, type));
+    if (num_inputs_ >= inputs->size()) {
+      inputs->push_back(CastTo(initial ? initial[i] : rand(), type));
+    }
+    num_inputs_ ++;
+  }
+
+  IFDEBUG(DumpMemory());
+  return first;
+}
+
+
+SymbolicInterpreter::ShadowRegion*
+SymbolicInterpreter::FindContainingRegion(addr_t addr, size_t* idx) {
+  map<addr_t,ShadowRegion>::iterator it = regions_.upper_bound(addr);
+  if (it == regions_.begin())
+    return NULL;
+  --it;
+
+  ShadowRegion& r = it->second;
+  if (addr >= r.end)
+    return NULL;
+
+  *idx = (addr - r.start) / r.elem_size;
+  return &r;
+}
+
+
+SymbolicInterpreter::ShadowRegion*
+SymbolicInterpreter::FindRegion(addr_t addr, size_t* idx) {
+  ShadowRegion* r = FindContainingRegion(addr, idx);
+  if (!r || (addr != r->start + *idx * r->elem_size))
+    return NULL;
+  return r;
+}
+
+
+void SymbolicInterpreter::RemoveRegions(addr_t begin, addr_t end) {
+  // Drop any symbolic memory inside [begin, end).
+  MemIt m = mem_.lower_bound(begin);
+  while ((m != mem_.end()) && (m->first < end)) {
+    delete m->second;
+    mem_.erase(m++);
+  }
+
+  // Any region overlapping [begin, end) is dissolved: its symbolic
+  // elements outside the range move to the ordinary memory map.
+  map<addr_t,ShadowRegion>::iterator it = regions_.lower_bound(begin);
+  if ((it != regions_.begin()) && ((it == regions_.end()) || (it->first > begin))) {
+    --it;
+    if (it->second.end <= begin)
+      ++it;
+  }
+  while ((it != regions_.end()) && (it->first < end)) {
+    ShadowRegion& r = it->second;
+    for (size_t i = 0; i < r.exprs.size(); i++) {
+      addr_t a = it->first + i * r.elem_size;
+      if ((a >= begin) && (a < end)) {
+        delete r.exprs[i];
+      } else if (r.fresh[i]) {
+        mem_[a] = new SymbolicExpr(1, r.first_var + i);
+      } else if (r.exprs[i]) {
+        mem_[a] = r.exprs[i];
+      }
+    }
+    regions_.erase(it++);
+  }
+}
+
+
 void SymbolicInterpreter::PushConcrete(value_t value) {
   PushSymbolic(NULL, value);
 }
@@ -50,6 +50,20 @@ class SymbolicInterpreter {
 
   value_t NewInput(type_t type, addr_t addr);
 
+  // Registers the 'n' elements of the given type starting at 'addr' as
+  // consecutive symbolic inputs, and returns the first of their variables.
+  // New inputs take their concrete values from 'initial' if given, and
+  // are random otherwise.  The inputs are tracked in a contiguous shadow
+  // region, rather than with one memory-map entry per element.
+  var_t NewInputBuffer(type_t type, addr_t addr, size_t n,
+                       const value_t* initial);
+
+  // Whether branch predicates are put in canonical form as they are
+  // recorded (see SymbolicPred::Normalize); on by default.  Normalize
+  // reasons over the integers, so the bit-vector solver needs the
+  // predicates as the program compared them.
+  void set_normalize(bool normalize) { normalize_ = normalize; }
+
   // Accessor for symbolic execution so far.
   const SymbolicExecution& execution() const { return ex_; }
 
@@ -72,9 +86,24 @@ class SymbolicInterpreter {
   // Is the top of the stack a function return value?
   bool return_value_;
 
+  bool normalize_;
+
   // Memory map.
   map<addr_t,SymbolicExpr*> mem_;
 
+  // Shadow memory for symbolic input buffers, keyed by start address.
+  // An element is either still its original input (fresh), holds a
+  // stored symbolic expression, or is concrete (expr NULL).
+  struct ShadowRegion {
+    addr_t start;
+    addr_t end;
+    size_t elem_size;
+    var_t first_var;
+    vector<SymbolicExpr*> exprs;
+    vector<bool> fresh;
+  };
+  map<addr_t,ShadowRegion> regions_;
+
   // The symbolic execution (program path and inputs).
   SymbolicExecution ex_;
 
@@ -85,6 +114,15 @@ class SymbolicInterpreter {
   inline void PushConcrete(value_t value);
   inline void PushSymbolic(SymbolicExpr* expr, value_t value);
   inline void ClearPredicateRegister();
+
+  // Returns the region with an element containing 'addr' (and the
+  // element's index in '*idx'), or NULL if there is none.
+  ShadowRegion* FindContainingRegion(addr_t addr, size_t* idx);
+  // As above, but NULL unless 'addr' is the start of the element.
+  ShadowRegion* FindRegion(addr_t addr, size_t* idx);
+  // Dissolves the regions overlapping [begin, end), and drops the
+  // symbolic memory inside it.
+  void RemoveRegions(addr_t begin, addr_t end);
 };
 
 }  // namespace crest
@@ -8,10 +8,17 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
+#include <limits>
+
 #include "base/symbolic_predicate.h"
 
 namespace crest {
 
+namespace {
+const value_t kMinValueT = std::numeric_limits<value_t>::min();
+const value_t kMaxValueT = std::numeric_limits<value_t>::max();
+}
+
 SymbolicPred::SymbolicPred()
   : op_(ops::EQ), expr_(new SymbolicExpr(0)) { }
 
@@ -23,7 +30,58 @@ SymbolicPred::~SymbolicPred() {
 }
 
 void SymbolicPred::Negate() {
-  op_ = NegateCompareOp(op_);
+  // !(e >= 0) <==> -e - 1 >= 0, which negates back to e >= 0 as long as
+  // no coefficient of e is the minimum value and its constant is neither
+  // extreme.  Otherwise !(e >= 0) is kept as e < 0.
+  if ((op_ == ops::GE) && expr_->CanNegate()
+      && (expr_->const_term() != kMaxValueT)) {
+    expr_->Negate();
+    *expr_ -= 1;
+  } else {
+    op_ = NegateCompareOp(op_);
+  }
+}
+
+void SymbolicPred::Normalize() {
+  if (expr_->IsConcrete())
+    return;
+
+  // Reduce the operator to EQ, NEQ, or GE.
+  switch (op_) {
+    case ops::GT:
+      if (expr_->const_term() == kMinValueT)
+        return;
+      *expr_ -= 1;
+      op_ = ops::GE;
+      break;
+    case ops::LE:
+    case ops::LT:
+      if (!expr_->CanNegate())
+        return;
+      expr_->Negate();
+      if (op_ == ops::LT)
+        *expr_ -= 1;
+      op_ = ops::GE;
+      break;
+    default:
+      break;
+  }
+
+  // Divide out the common factor of the coefficients.
+  value_t g = expr_->CoeffGcd();
+  if (g > 1) {
+    if (op_ == ops::GE) {
+      expr_->DivideFloor(g);
+    } else if (expr_->const_term() % g == 0) {
+      expr_->DivideFloor(g);
+    }
+  }
+
+  // Fix the sign of (dis)equalities.
+  if ((op_ != ops::GE)
+      && (expr_->terms().begin()->second < 0) && expr_->CanNegate()) {
+    expr_->Negate();
+  }
 }
 
 void SymbolicPred::AppendToString(string* s) const {
@@ -49,5 +107,26 @@ bool SymbolicPred::Equal(const SymbolicPred& p) const {
   return ((op_ == p.op_) && (*expr_ == *p.expr_));
 }
 
+bool SymbolicPred::IsSatisfiedBy(const map<var_t,value_t>& assignment) const {
+  value_t val;
+  if (!expr_->Evaluate(assignment, &val))
+    return false;
+
+  switch (op_) {
+    case ops::EQ:  return val == 0;
+    case ops::NEQ: return val != 0;
+    case ops::GT:  return val > 0;
+    case ops::LE:  return val <= 0;
+    case ops::LT:  return val < 0;
+    case ops::GE:  return val >= 0;
+  }
+  return false;
+}
+
+hash_t SymbolicPred::Hash() const {
+  // Mix the operator into the expression hash (one FNV-1a step).
+  return (expr_->Hash() ^ static_cast<hash_t>(op_ + 1)) * 1099511628211ULL;
+}
+
 
 }  // namespace crest
@@ -31,7 +31,24 @@ class SymbolicPred {
   SymbolicPred(compare_op_t op, SymbolicExpr* expr);
   ~SymbolicPred();
 
+  // Negates the predicate.  e >= 0 becomes -e - 1 >= 0, unless that
+  // would not negate back exactly (near the ends of value_t), in which
+  // case it becomes e < 0.  Negating any predicate that Normalize leaves
+  // twice gives back the original.  (A predicate built as e < 0 with a
+  // negatable e would come back as -e - 1 >= 0, which is equivalent but
+  // compares unequal.)
   void Negate();
+
+  // Rewrites the predicate into an equivalent canonical form, so that
+  // equivalent constraints compare Equal and Hash identically:
+  //  - the operator is one of EQ, NEQ, or GE (e > 0, e <= 0, and e < 0
+  //    become e - 1 >= 0, -e >= 0, and -e - 1 >= 0 over the integers),
+  //  - the coefficients are divided by their GCD (for GE the constant is
+  //    rounded down; for EQ and NEQ only when it divides the constant),
+  //  - for EQ and NEQ, the first coefficient is positive.
+  // A step that would overflow is skipped.
+  void Normalize();
+
   void AppendToString(string* s) const;
 
   void Serialize(string* s) const;
@@ -39,6 +56,13 @@ class SymbolicPred {
 
   bool Equal(const SymbolicPred& p) const;
 
+  // A 64-bit hash of the predicate, stable across runs and processes.
+  hash_t Hash() const;
+
+  // Returns true if the predicate holds under 'assignment', which must
+  // contain all of its variables.  (False if the evaluation overflows.)
+  bool IsSatisfiedBy(const map<var_t,value_t>& assignment) const;
+
   void AppendVars(set<var_t>* vars) const {
     expr_->AppendVars(vars);
   }
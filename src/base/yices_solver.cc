@@ -8,24 +8,733 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
 // for details.
 
+#include <algorithm>
 #include <assert.h>
+#include <errno.h>
+#include <iterator>
+#include <limits.h>
+#include <poll.h>
 #include <queue>
 #include <set>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <utility>
 #include <yices_c.h>
 
+#include "base/fast_solver.h"
+#include "base/query_log.h"
+#include "base/solver_cache.h"
 #include "base/yices_solver.h"
 
 using std::make_pair;
+using std::max;
+using std::min;
 using std::queue;
 using std::set;
+using std::string;
 
 namespace crest {
 
   typedef vector<const SymbolicPred*>::const_iterator PredIt;
 
+namespace {
+
+  double WallTime() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+  }
+
+  // With bit-vectors, every variable is a bit-vector of its type's width,
+  // and each constraint is evaluated in value_t's wrap-around arithmetic
+  // (as the symbolic interpreter does), at the narrowest width where that
+  // is exact (see BvWidth).  Otherwise variables are unbounded integers
+  // with type-range bounds.
+  bool use_bitvectors = false;
+  const unsigned kBvWidth = 8 * sizeof(value_t);
+
+  // The constant 'v' in the current encoding (truncated to 'width' bits,
+  // for bit-vectors).
+  yices_expr MakeNum(yices_context ctx, value_t v, unsigned width = kBvWidth) {
+    if (use_bitvectors) {
+      unsigned long u = static_cast<unsigned long>(v);
+      if (width < kBvWidth)
+        u &= (1UL << width) - 1;
+      return yices_mk_bv_constant(ctx, width, u);
+    }
+    if ((v >= INT_MIN) && (v <= INT_MAX))
+      return yices_mk_num(ctx, static_cast<int>(v));
+    char buff[32];
+    snprintf(buff, sizeof(buff), "%lld", v);
+    return yices_mk_num_from_string(ctx, buff);
+  }
+
+  // The comparison 'a op b' in the current encoding (signed, for
+  // bit-vectors).
+  yices_expr MakeCompare(yices_context ctx, compare_op_t op,
+                         yices_expr a, yices_expr b) {
+    switch(op) {
+      case ops::EQ:  return yices_mk_eq(ctx, a, b);
+      case ops::NEQ: return yices_mk_diseq(ctx, a, b);
+      case ops::GT:  return use_bitvectors ? yices_mk_bv_sgt(ctx, a, b) : yices_mk_gt(ctx, a, b);
+      case ops::LE:  return use_bitvectors ? yices_mk_bv_sle(ctx, a, b) : yices_mk_le(ctx, a, b);
+      case ops::LT:  return use_bitvectors ? yices_mk_bv_slt(ctx, a, b) : yices_mk_lt(ctx, a, b);
+      case ops::GE:  return use_bitvectors ? yices_mk_bv_sge(ctx, a, b) : yices_mk_ge(ctx, a, b);
+      default:
+                     fprintf(stderr, "Unknown comparison operator: %d\n", op);
+                     exit(1);
+    }
+  }
+
+  // The bit-vector variable 'x' of type 'ty', sign- or zero-extended from
+  // its type's width to 'width' bits.
+  yices_expr ExtendBv(yices_context ctx, yices_expr x, type_t ty,
+                      unsigned width) {
+    unsigned bits = 8 * kByteSize[ty];
+    if (bits == width)
+      return x;
+    if (kMinValue[ty] < 0)
+      return yices_mk_bv_sign_extend(ctx, x, width - bits);
+    return yices_mk_bv_concat(ctx, yices_mk_bv_constant(ctx, width - bits, 0), x);
+  }
+
+  // The comparison 'x op v' for the variable 'x' of type 'ty' (declared
+  // at its type's width, for bit-vectors).
+  yices_expr MakeVarCompare(yices_context ctx, compare_op_t op,
+                            yices_expr x, type_t ty, value_t v) {
+    if (use_bitvectors)
+      x = ExtendBv(ctx, x, ty, kBvWidth);
+    return MakeCompare(ctx, op, x, MakeNum(ctx, v));
+  }
+
+  // The width at which 'se' is evaluated with bit-vectors: the narrowest
+  // of 8, 16, 32, and 64 bits that holds each of its variables and every
+  // value the expression can take over its variables' types.  Arithmetic
+  // modulo 2^width then gives the same value as value_t arithmetic, so
+  // the narrowing is exact; otherwise 64 bits wrap as value_t does.
+  unsigned BvWidth(const map<var_t,type_t>& vars, const SymbolicExpr& se) {
+    unsigned width = 8;
+    double lo = static_cast<double>(se.const_term());
+    double hi = lo;
+    for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
+      type_t ty = vars.find(j->first)->second;
+      width = max(width, static_cast<unsigned>(8 * kByteSize[ty]));
+      double a = static_cast<double>(j->second) * kMinValue[ty];
+      double b = static_cast<double>(j->second) * kMaxValue[ty];
+      lo += min(a, b);
+      hi += max(a, b);
+    }
+    for (; width < kBvWidth; width *= 2) {
+      double half = static_cast<double>(1ULL << (width - 1));
+      if ((lo >= -half) && (hi < half))
+        break;
+    }
+    return width;
+  }
+
+  // Builds the Yices assertion for 'pred'.  Every variable of 'pred' must
+  // already be in 'x_expr'.
+  yices_expr MakePred(yices_context ctx, map<var_t,yices_expr>& x_expr,
+                      yices_expr zero, const SymbolicPred& pred) {
+    const SymbolicExpr& se = pred.expr();
+    vector<yices_expr> terms;
+    terms.push_back(MakeNum(ctx, se.const_term()));
+    for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
+      yices_expr prod[2] = { x_expr[j->first], MakeNum(ctx, j->second) };
+      terms.push_back(yices_mk_mul(ctx, prod, 2));
+    }
+    yices_expr e = yices_mk_sum(ctx, &terms.front(), terms.size());
+    return MakeCompare(ctx, pred.op(), e, zero);
+  }
+
+  // MakePred for bit-vectors, whose variables in 'x_expr' (of the types
+  // in 'vars') are extended to the predicate's width (see BvWidth).
+  yices_expr MakeBvPred(yices_context ctx, const map<var_t,type_t>& vars,
+                        map<var_t,yices_expr>& x_expr,
+                        const SymbolicPred& pred) {
+    const SymbolicExpr& se = pred.expr();
+    unsigned width = BvWidth(vars, se);
+    yices_expr e = MakeNum(ctx, se.const_term(), width);
+    for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
+      yices_expr x = ExtendBv(ctx, x_expr[j->first], vars.find(j->first)->second, width);
+      e = yices_mk_bv_add(ctx, e, yices_mk_bv_mul(ctx, x, MakeNum(ctx, j->second, width)));
+    }
+    return MakeCompare(ctx, pred.op(), e, MakeNum(ctx, 0, width));
+  }
+
+  // A long-lived Yices context holding a prefix of some path.  Level i+1
+  // of the context stack holds the i-th asserted constraint, together
+  // with the type bounds of any variable that constraint mentions first.
+  class YicesSession {
+   public:
+    YicesSession();
+    ~YicesSession();
+
+    size_t depth() const { return keys_.size(); }
+
+    // Returns the number of leading constraints among cs[0..n) that are
+    // already asserted, compared by content.
+    size_t CommonPrefix(const SymbolicPred* const* cs, size_t n) const;
+
+    // Pops back to the first 'n' asserted constraints.
+    void Truncate(size_t n);
+
+    // Asserts 'pred' at a new level.
+    void Assert(const SymbolicPred& pred, const map<var_t,type_t>& vars);
+
+    // Checks the asserted prefix together with 'pred', which is retracted
+    // again before returning.  On l_true, stores the values of 'out_vars'
+    // in 'soln'.
+    lbool CheckWith(const SymbolicPred& pred, const map<var_t,type_t>& vars,
+                    const map<var_t,type_t>& out_vars,
+                    map<var_t,value_t>* soln);
+
+    // Returns true if the asserted prefix is itself satisfiable.  The
+    // prefix can be inconsistent when the symbolic path is imprecise
+    // (e.g. after an overflow); such queries are left to independent mode.
+    bool PrefixIsSat();
+
+   private:
+    void DeclareVars(const SymbolicPred& pred, const map<var_t,type_t>& vars,
+                     vector<var_t>* bounded);
+
+    yices_context ctx_;
+    yices_type int_ty_;
+    yices_expr zero_;
+    vector<yices_expr> min_expr_;
+    vector<yices_expr> max_expr_;
+    map<var_t,yices_var_decl> x_decl_;
+    map<var_t,yices_expr> x_expr_;
+
+    // Serialized constraint and newly bounded variables at each level.
+    vector<string> keys_;
+    vector< vector<var_t> > bounded_at_;
+    set<var_t> bounded_;
+
+    // Longest prefix known to be satisfiable, shortest known not to be.
+    size_t sat_depth_;
+    size_t unsat_depth_;
+  };
+
+  YicesSession::YicesSession() : sat_depth_(0), unsat_depth_(static_cast<size_t>(-1)) {
+    ctx_ = yices_mk_context();
+    assert(ctx_);
+
+    min_expr_.resize(types::LONG_LONG+1);
+    max_expr_.resize(types::LONG_LONG+1);
+    for (int i = types::U_CHAR; i <= types::LONG_LONG; i++) {
+      min_expr_[i] = yices_mk_num_from_string(ctx_, const_cast<char*>(kMinValueStr[i]));
+      max_expr_[i] = yices_mk_num_from_string(ctx_, const_cast<char*>(kMaxValueStr[i]));
+      assert(min_expr_[i]);
+      assert(max_expr_[i]);
+    }
+
+    char int_ty_name[] = "int";
+    int_ty_ = yices_mk_type(ctx_, int_ty_name);
+    assert(int_ty_);
+    zero_ = yices_mk_num(ctx_, 0);
+    assert(zero_);
+  }
+
+  YicesSession::~YicesSession() {
+    yices_del_context(ctx_);
+  }
+
+  size_t YicesSession::CommonPrefix(const SymbolicPred* const* cs,
+                                    size_t n) const {
+    size_t i = 0;
+    string key;
+    for (; (i < n) && (i < keys_.size()); i++) {
+      key.clear();
+      cs[i]->Serialize(&key);
+      if (key != keys_[i])
+        break;
+    }
+    return i;
+  }
+
+  void YicesSession::Truncate(size_t n) {
+    while (keys_.size() > n) {
+      yices_pop(ctx_);
+      const vector<var_t>& vs = bounded_at_.back();
+      for (size_t i = 0; i < vs.size(); i++)
+        bounded_.erase(vs[i]);
+      bounded_at_.pop_back();
+      keys_.pop_back();
+    }
+    sat_depth_ = std::min(sat_depth_, n);
+    if (unsat_depth_ > n)
+      unsat_depth_ = static_cast<size_t>(-1);
+  }
+
+  void YicesSession::DeclareVars(const SymbolicPred& pred,
+                                 const map<var_t,type_t>& vars,
+                                 vector<var_t>* bounded) {
+    const SymbolicExpr& se = pred.expr();
+    for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
+      var_t v = j->first;
+      if (x_decl_.find(v) == x_decl_.end()) {
+        char buff[32];
+        snprintf(buff, sizeof(buff), "x%d", v);
+        x_decl_[v] = yices_mk_var_decl(ctx_, buff, int_ty_);
+        x_expr_[v] = yices_mk_var_from_decl(ctx_, x_decl_[v]);
+        assert(x_decl_[v]);
+        assert(x_expr_[v]);
+      }
+      if (bounded_.insert(v).second) {
+        type_t ty = vars.find(v)->second;
+        yices_assert(ctx_, yices_mk_ge(ctx_, x_expr_[v], min_expr_[ty]));
+        yices_assert(ctx_, yices_mk_le(ctx_, x_expr_[v], max_expr_[ty]));
+        bounded->push_back(v);
+      }
+    }
+  }
+
+  void YicesSession::Assert(const SymbolicPred& pred,
+                            const map<var_t,type_t>& vars) {
+    yices_push(ctx_);
+    bounded_at_.push_back(vector<var_t>());
+    DeclareVars(pred, vars, &bounded_at_.back());
+    yices_assert(ctx_, MakePred(ctx_, x_expr_, zero_, pred));
+    keys_.push_back(string());
+    pred.Serialize(&keys_.back());
+  }
+
+  lbool YicesSession::CheckWith(const SymbolicPred& pred,
+                                const map<var_t,type_t>& vars,
+                                const map<var_t,type_t>& out_vars,
+                                map<var_t,value_t>* soln) {
+    yices_push(ctx_);
+    vector<var_t> bounded;
+    DeclareVars(pred, vars, &bounded);
+    yices_assert(ctx_, MakePred(ctx_, x_expr_, zero_, pred));
+
+    lbool res = yices_check(ctx_);
+    if (res == l_true) {
+      sat_depth_ = depth();
+      yices_model model = yices_get_model(ctx_);
+      typedef map<var_t,type_t>::const_iterator VarIt;
+      for (VarIt i = out_vars.begin(); i != out_vars.end(); ++i) {
+        long val;
+        int ok = yices_get_int_value(model, x_decl_[i->first], &val);
+        assert(ok);
+        soln->insert(make_pair(i->first, val));
+      }
+    }
+
+    yices_pop(ctx_);
+    for (size_t i = 0; i < bounded.size(); i++)
+      bounded_.erase(bounded[i]);
+    return res;
+  }
+
+  bool YicesSession::PrefixIsSat() {
+    if (sat_depth_ >= depth())
+      return true;
+    if (unsat_depth_ <= depth())
+      return false;
+    if (yices_check(ctx_) == l_true) {
+      sat_depth_ = depth();
+      return true;
+    }
+    unsat_depth_ = depth();
+    return false;
+  }
+
+  // Makes a fresh context asserting the type bounds of 'vars' and
+  // 'constraints', and stores the variables' declarations in 'x_decl'.
+  yices_context MakeContext(const map<var_t,type_t>& vars,
+                            const vector<const SymbolicPred*>& constraints,
+                            map<var_t,yices_var_decl>* x_decl,
+                            map<var_t,yices_expr>* x_expr) {
+    typedef map<var_t,type_t>::const_iterator VarIt;
+
+    yices_context ctx = yices_mk_context();
+    assert(ctx);
+
+    if (use_bitvectors) {
+      // Variable declarations, at their types' widths.
+      for (VarIt i = vars.begin(); i != vars.end(); ++i) {
+        char buff[32];
+        snprintf(buff, sizeof(buff), "x%d", i->first);
+        yices_type ty = yices_mk_bitvector_type(ctx, 8 * kByteSize[i->second]);
+        (*x_decl)[i->first] = yices_mk_var_decl(ctx, buff, ty);
+        (*x_expr)[i->first] = yices_mk_var_from_decl(ctx, (*x_decl)[i->first]);
+        assert((*x_decl)[i->first]);
+        assert((*x_expr)[i->first]);
+      }
+    } else {
+      // Type limits.
+      vector<yices_expr> min_expr(types::LONG_LONG+1);
+      vector<yices_expr> max_expr(types::LONG_LONG+1);
+      for (int i = types::U_CHAR; i <= types::LONG_LONG; i++) {
+        min_expr[i] = yices_mk_num_from_string(ctx, const_cast<char*>(kMinValueStr[i]));
+        max_expr[i] = yices_mk_num_from_string(ctx, const_cast<char*>(kMaxValueStr[i]));
+        assert(min_expr[i]);
+        assert(max_expr[i]);
+      }
+
+      char int_ty_name[] = "int";
+      // fprintf(stderr, "yices_mk_mk_type(ctx, int_ty_name)\n");
+      yices_type int_ty = yices_mk_type(ctx, int_ty_name);
+      assert(int_ty);
+
+      // Variable declarations.
+      for (VarIt i = vars.begin(); i != vars.end(); ++i) {
+        char buff[32];
+        snprintf(buff, sizeof(buff), "x%d", i->first);
+        // fprintf(stderr, "yices_mk_var_decl(ctx, buff, int_ty)\n");
+        (*x_decl)[i->first] = yices_mk_var_decl(ctx, buff, int_ty);
+        // fprintf(stderr, "yices_mk_var_from_decl(ctx, x_decl[i->first])\n");
+        (*x_expr)[i->first] = yices_mk_var_from_decl(ctx, (*x_decl)[i->first]);
+        assert((*x_decl)[i->first]);
+        assert((*x_expr)[i->first]);
+        yices_assert(ctx, yices_mk_ge(ctx, (*x_expr)[i->first], min_expr[i->second]));
+        yices_assert(ctx, yices_mk_le(ctx, (*x_expr)[i->first], max_expr[i->second]));
+      }
+    }
+
+    yices_expr zero = MakeNum(ctx, 0);
+    assert(zero);
+
+    // Constraints.
+    for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
+      if (use_bitvectors) {
+        yices_assert(ctx, MakeBvPred(ctx, vars, *x_expr, **i));
+      } else {
+        yices_assert(ctx, MakePred(ctx, *x_expr, zero, **i));
+      }
+    }
+    return ctx;
+  }
+
+  // Reads the values of 'vars' out of the model of 'ctx'.
+  void GetModel(yices_context ctx, const map<var_t,type_t>& vars,
+                map<var_t,yices_var_decl>& x_decl,
+                map<var_t,value_t>* soln) {
+    soln->clear();
+    yices_model model = yices_get_model(ctx);
+    for (map<var_t,type_t>::const_iterator i = vars.begin(); i != vars.end(); ++i) {
+      value_t val;
+      if (use_bitvectors) {
+        unsigned bits = 8 * kByteSize[i->second];
+        int bv[kBvWidth];
+        int ok = yices_get_bitvector_value(model, x_decl[i->first], bits, bv);
+        assert(ok);
+        unsigned long long u = 0;
+        for (unsigned b = bits; b-- > 0; )
+          u = (u << 1) | (bv[b] ? 1 : 0);
+        val = CastTo(static_cast<value_t>(u), i->second);
+      } else {
+        long l;
+        int ok = yices_get_int_value(model, x_decl[i->first], &l);
+        assert(ok);
+        val = l;
+      }
+      soln->insert(soln->end(), make_pair(i->first, val));
+    }
+  }
+
+  // Reads the dependent slice of the 'idx'-th constraint of 'ex' off
+  // ex.slices().
+  void GetSlice(const SymbolicExecution& ex, size_t idx,
+                map<var_t,type_t>* dependent_vars,
+                vector<const SymbolicPred*>* dependent_constraints) {
+    const vector<SymbolicPred*>& constraints = ex.path().constraints();
+    const map<var_t,type_t>& vars = ex.vars();
+
+    vector<size_t> slice;
+    ex.slices().Slice(idx, &slice);
+
+    dependent_constraints->reserve(slice.size());
+    for (size_t i = 0; i < slice.size(); i++) {
+      const SymbolicPred* p = constraints[slice[i]];
+      dependent_constraints->push_back(p);
+      const map<var_t,value_t>& terms = p->expr().terms();
+      for (SymbolicExpr::TermIt j = terms.begin(); j != terms.end(); ++j) {
+        dependent_vars->insert(*vars.find(j->first));
+      }
+    }
+  }
+
+  YicesSession* session = NULL;
+  SolverCache* cache = NULL;
+  QueryLog* query_log = NULL;
+  bool use_fast_solver = false;
+  double timeout_secs = 0.0;
+  size_t window = 0;
+  vector<CachedAnswer>* recorded_answers = NULL;
+
+  void CacheAnswer(const SolverCache::Key& key, bool sat,
+                   const map<var_t,value_t>& soln) {
+    cache->Insert(key, sat, soln);
+    if (recorded_answers) {
+      recorded_answers->push_back(CachedAnswer());
+      CachedAnswer& a = recorded_answers->back();
+      a.key = key;
+      a.sat = sat;
+      a.soln = soln;
+    }
+  }
+
+  bool WriteAll(int fd, const char* buf, size_t n) {
+    while (n > 0) {
+      ssize_t k = write(fd, buf, n);
+      if (k < 0 && errno == EINTR)
+        continue;
+      if (k <= 0)
+        return false;
+      buf += k;
+      n -= k;
+    }
+    return true;
+  }
+
+  // Reads the reply of the solver child 'pid' from 'fd' until EOF, then
+  // reaps the child.  Returns false (having killed the child) if the
+  // timeout ran out first.
+  bool ReadChild(int fd, pid_t pid, string* reply) {
+    const double deadline = WallTime() + timeout_secs;
+    bool answered = true;
+    char buf[4096];
+    while (true) {
+      int ms = static_cast<int>((deadline - WallTime()) * 1000.0);
+      struct pollfd pfd = { fd, POLLIN, 0 };
+      int r = poll(&pfd, 1, (ms > 0) ? ms : 0);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0) {
+        answered = false;
+        kill(pid, SIGKILL);
+        break;
+      }
+      ssize_t k = read(fd, buf, sizeof(buf));
+      if (k < 0 && errno == EINTR)
+        continue;
+      if (k <= 0)
+        break;
+      reply->append(buf, k);
+    }
+    close(fd);
+    waitpid(pid, NULL, 0);
+    return answered;
+  }
+
+}  // namespace
+
+  SolverStats YicesSolver::stats_;
+
+  void YicesSolver::EnableSession(bool enable) {
+    delete session;
+    session = enable ? new YicesSession() : NULL;
+  }
+
+  void YicesSolver::EnableCache(bool enable) {
+    delete cache;
+    cache = enable ? new SolverCache() : NULL;
+  }
+
+  void YicesSolver::EnableFastSolver(bool enable) {
+    use_fast_solver = enable;
+  }
+
+  void YicesSolver::EnableBitVectors(bool enable) {
+    use_bitvectors = enable;
+  }
+
+  void YicesSolver::SetTimeout(double secs) {
+    timeout_secs = (secs > 0.0) ? secs : 0.0;
+  }
+
+  bool YicesSolver::EnableQueryLog(const string& file) {
+    delete query_log;
+    query_log = new QueryLog();
+    if (!query_log->Open(file)) {
+      delete query_log;
+      query_log = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  void YicesSolver::SetWindow(size_t n) {
+    window = n;
+  }
+
+  void YicesSolver::RecordCachedAnswers(vector<CachedAnswer>* answers) {
+    recorded_answers = answers;
+  }
+
+  void YicesSolver::AddCachedAnswer(const CachedAnswer& answer) {
+    if (cache)
+      cache->Insert(answer.key, answer.sat, answer.soln);
+  }
+
+  bool YicesSolver::EnablePersistentCache(const string& dir,
+                                          const string& program) {
+    if (!cache)
+      EnableCache(true);
+    // Answers differ between the encodings, so they get separate files.
+    return cache->OpenPersistent(dir, program, use_bitvectors ? "bv" : "");
+  }
+
+  bool YicesSolver::SessionSolve(const map<var_t,type_t>& vars,
+      const SymbolicPred* const* constraints,
+      size_t num_constraints,
+      const map<var_t,type_t>& dependent_vars,
+      size_t num_dependent_constraints,
+      map<var_t,value_t>* soln,
+      bool* success) {
+    if (!session || (num_constraints == 0))
+      return false;
+
+    // Only use the session if it needs at most as many new assertions as
+    // the independent query would make.
+    size_t n = num_constraints - 1;
+    size_t common = session->CommonPrefix(constraints, n);
+    if (n - common + 1 > num_dependent_constraints)
+      return false;
+
+    session->Truncate(common);
+    for (size_t i = common; i < n; i++) {
+      session->Assert(*constraints[i], vars);
+    }
+
+    lbool res = session->CheckWith(*constraints[n], vars, dependent_vars, soln);
+    if ((res == l_undef) || ((res == l_false) && !session->PrefixIsSat())) {
+      soln->clear();
+      return false;
+    }
+    *success = (res == l_true);
+    return true;
+  }
+
+
+  bool YicesSolver::SolveSlice(const vector<value_t>& old_soln,
+      const map<var_t,type_t>& vars,
+      const SymbolicPred* const* constraints,
+      size_t num_constraints,
+      const map<var_t,type_t>& dependent_vars,
+      const vector<const SymbolicPred*>& dependent_constraints,
+      map<var_t,value_t>* soln) {
+    soln->clear();
+    double query_start = WallTime();
+    tier_t tier = tiers::CACHE;
+    bool success;
+    SolverCache::Result cached = SolverCache::MISS;
+    SolverCache::Key key;
+    if (cache) {
+      stats_.num_cache_lookups++;
+      cached = cache->Lookup(old_soln, dependent_vars, dependent_constraints,
+                             &key, soln, &success);
+      switch (cached) {
+        case SolverCache::EXACT_HIT:        stats_.num_exact_hits++; break;
+        case SolverCache::PERSISTENT_HIT:   stats_.num_persistent_hits++; break;
+        case SolverCache::UNSAT_SUBSET_HIT: stats_.num_unsat_subset_hits++; break;
+        case SolverCache::MODEL_HIT:        stats_.num_model_hits++; break;
+        case SolverCache::MISS:             break;
+      }
+    }
+
+    FastSolver::Result fast = FastSolver::UNKNOWN;
+    if ((cached == SolverCache::MISS) && use_fast_solver) {
+      tier = tiers::FAST;
+      double start = WallTime();
+      fast = FastSolver::Solve(old_soln, dependent_vars, dependent_constraints, soln);
+      stats_.fast_secs += WallTime() - start;
+      switch (fast) {
+        case FastSolver::SAT:     stats_.num_fast_sat++; success = true; break;
+        case FastSolver::UNSAT:   stats_.num_fast_unsat++; success = false; break;
+        case FastSolver::UNKNOWN: stats_.num_fast_unknown++; soln->clear(); break;
+      }
+      // The fast path reasons over the integers, so its models (verified
+      // without overflow) hold with bit-vectors too, but its UNSAT may not.
+      if ((fast == FastSolver::UNSAT) && use_bitvectors) {
+        stats_.num_fast_unsat--;
+        stats_.num_fast_unknown++;
+        fast = FastSolver::UNKNOWN;
+      }
+      if ((fast != FastSolver::UNKNOWN) && cache)
+        CacheAnswer(key, success, *soln);
+    }
+
+    if ((cached == SolverCache::MISS) && (fast == FastSolver::UNKNOWN)) {
+      double start = WallTime();
+      bool timed_out = false;
+      if ((timeout_secs == 0.0) && !use_bitvectors
+          && SessionSolve(vars, constraints, num_constraints, dependent_vars,
+                          dependent_constraints.size(), soln, &success)) {
+        stats_.num_session_solves++;
+        stats_.session_secs += WallTime() - start;
+        tier = tiers::SESSION;
+      } else {
+        if (timeout_secs > 0.0) {
+          success = TimedSolve(dependent_vars, dependent_constraints, soln,
+                               &timed_out);
+        } else {
+          success = Solve(dependent_vars, dependent_constraints, soln);
+        }
+        stats_.num_independent_solves++;
+        stats_.independent_secs += WallTime() - start;
+        tier = tiers::INDEPENDENT;
+      }
+      if (timed_out) {
+        stats_.num_timeouts++;
+        tier = tiers::TIMEOUT;
+      } else if (cache) {
+        CacheAnswer(key, success, *soln);
+      }
+    }
+
+    if (query_log) {
+      query_log->Append(old_soln, dependent_vars, dependent_constraints,
+                        success, tier, WallTime() - query_start);
+    }
+    return success;
+  }
+
+
+  bool YicesSolver::IncrementalSolve(const SymbolicExecution& ex,
+      size_t idx,
+      map<var_t,value_t>* soln,
+      bool* windowed) {
+    const vector<SymbolicPred*>& constraints = ex.path().constraints();
+    map<var_t,type_t> dependent_vars;
+    vector<const SymbolicPred*> dependent_constraints;
+    GetSlice(ex, idx, &dependent_vars, &dependent_constraints);
+    bool truncate = (window > 0) && (dependent_constraints.size() > window);
+    if (windowed)
+      *windowed = truncate;
+    if (!truncate) {
+      return SolveSlice(ex.inputs(), ex.vars(), &constraints.front(), idx + 1,
+                        dependent_vars, dependent_constraints, soln);
+    }
+
+    // Keep the most recent constraints of the slice (it is in path
+    // order, ending with the negated one) and only their variables.
+    stats_.num_windowed_solves++;
+    stats_.num_window_dropped += dependent_constraints.size() - window;
+    dependent_constraints.erase(dependent_constraints.begin(),
+                                dependent_constraints.end() - window);
+    dependent_vars.clear();
+    for (PredIt i = dependent_constraints.begin(); i != dependent_constraints.end(); ++i) {
+      const map<var_t,value_t>& terms = (*i)->expr().terms();
+      for (SymbolicExpr::TermIt j = terms.begin(); j != terms.end(); ++j) {
+        dependent_vars.insert(*ex.vars().find(j->first));
+      }
+    }
+    // The window is not the slice of any path prefix, so no prefix is
+    // passed (which keeps it out of the session).
+    return SolveSlice(ex.inputs(), ex.vars(), NULL, 0,
+                      dependent_vars, dependent_constraints, soln);
+  }
+
 
   bool YicesSolver::IncrementalSolve(const vector<value_t>& old_soln,
       const map<var_t,type_t>& vars,
@@ -76,8 +785,11 @@ namespace crest {
         dependent_constraints.push_back(*i);
     }
 
-    soln->clear();
-    if (Solve(dependent_vars, dependent_constraints, soln)) {
+    bool success = SolveSlice(old_soln, vars, &constraints.front(),
+                              constraints.size(), dependent_vars,
+                              dependent_constraints, soln);
+
+    if (success) {
       // Merge in the constrained variables.
       for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
         (*i)->AppendVars(&tmp);
@@ -97,91 +809,246 @@ namespace crest {
   bool YicesSolver::Solve(const map<var_t,type_t>& vars,
       const vector<const SymbolicPred*>& constraints,
       map<var_t,value_t>* soln) {
+    map<var_t,yices_var_decl> x_decl;
+    map<var_t,yices_expr> x_expr;
+    yices_context ctx = MakeContext(vars, constraints, &x_decl, &x_expr);
 
-    typedef map<var_t,type_t>::const_iterator VarIt;
+    bool success = (yices_check(ctx) == l_true);
+    if (success)
+      GetModel(ctx, vars, x_decl, soln);
 
-    yices_enable_log_file("yices_log");
-    yices_context ctx = yices_mk_context();
-    assert(ctx);
+    yices_del_context(ctx);
+    return success;
+  }
 
-    // Type limits.
-    vector<yices_expr> min_expr(types::LONG_LONG+1);
-    vector<yices_expr> max_expr(types::LONG_LONG+1);
-    for (int i = types::U_CHAR; i <= types::LONG_LONG; i++) {
-      min_expr[i] = yices_mk_num_from_string(ctx, const_cast<char*>(kMinValueStr[i]));
-      max_expr[i] = yices_mk_num_from_string(ctx, const_cast<char*>(kMaxValueStr[i]));
-      assert(min_expr[i]);
-      assert(max_expr[i]);
+
+  void YicesSolver::ExtraModels(const SymbolicExecution& ex,
+      size_t idx,
+      const map<var_t,value_t>& soln,
+      size_t num_models,
+      vector< map<var_t,value_t> >* models) {
+    models->clear();
+    if (num_models == 0)
+      return;
+
+    map<var_t,type_t> vars;
+    vector<const SymbolicPred*> constraints;
+    GetSlice(ex, idx, &vars, &constraints);
+    if (vars.empty())
+      return;
+
+    if (timeout_secs > 0.0) {
+      bool timed_out = false;
+      TimedModels(vars, constraints, soln, num_models, models, &timed_out);
+      if (timed_out)
+        stats_.num_timeouts++;
+    } else {
+      FindModels(vars, constraints, soln, num_models, models);
     }
+  }
 
-    char int_ty_name[] = "int";
-    // fprintf(stderr, "yices_mk_mk_type(ctx, int_ty_name)\n");
-    yices_type int_ty = yices_mk_type(ctx, int_ty_name);
-    assert(int_ty);
 
-    // Variable declarations.
+  void YicesSolver::FindModels(const map<var_t,type_t>& vars,
+      const vector<const SymbolicPred*>& constraints,
+      const map<var_t,value_t>& soln,
+      size_t num_models,
+      vector< map<var_t,value_t> >* models) {
     map<var_t,yices_var_decl> x_decl;
     map<var_t,yices_expr> x_expr;
-    for (VarIt i = vars.begin(); i != vars.end(); ++i) {
-      char buff[32];
-      snprintf(buff, sizeof(buff), "x%d", i->first);
-      // fprintf(stderr, "yices_mk_var_decl(ctx, buff, int_ty)\n");
-      x_decl[i->first] = yices_mk_var_decl(ctx, buff, int_ty);
-      // fprintf(stderr, "yices_mk_var_from_decl(ctx, x_decl[i->first])\n");
-      x_expr[i->first] = yices_mk_var_from_decl(ctx, x_decl[i->first]);
-      assert(x_decl[i->first]);
-      assert(x_expr[i->first]);
-      // fprintf(stderr, "yices_assert(ctx, yices_mk_ge(ctx, x_expr[i->first], min_expr[i->second]))\n");
-      yices_assert(ctx, yices_mk_ge(ctx, x_expr[i->first], min_expr[i->second]));
-      // fprintf(stderr, "yices_assert(ctx, yices_mk_le(ctx, x_expr[i->first], max_expr[i->second]))\n");
-      yices_assert(ctx, yices_mk_le(ctx, x_expr[i->first], max_expr[i->second]));
-    }
-
-    // fprintf(stderr, "yices_mk_num(ctx, 0)\n");
-    yices_expr zero = yices_mk_num(ctx, 0);
-    assert(zero);
+    yices_context ctx = MakeContext(vars, constraints, &x_decl, &x_expr);
 
-    { // Constraints.
-      vector<yices_expr> terms;
-      for (PredIt i = constraints.begin(); i != constraints.end(); ++i) {
-        const SymbolicExpr& se = (*i)->expr();
-        terms.clear();
-        terms.push_back(yices_mk_num(ctx, se.const_term()));
-        for (SymbolicExpr::TermIt j = se.terms().begin(); j != se.terms().end(); ++j) {
-          yices_expr prod[2] = { x_expr[j->first], yices_mk_num(ctx, j->second) };
-          terms.push_back(yices_mk_mul(ctx, prod, 2));
-        }
-        yices_expr e = yices_mk_sum(ctx, &terms.front(), terms.size());
-
-        yices_expr pred;
-        switch((*i)->op()) {
-          case ops::EQ:  pred = yices_mk_eq(ctx, e, zero); break;
-          case ops::NEQ: pred = yices_mk_diseq(ctx, e, zero); break;
-          case ops::GT:  pred = yices_mk_gt(ctx, e, zero); break;
-          case ops::LE:  pred = yices_mk_le(ctx, e, zero); break;
-          case ops::LT:  pred = yices_mk_lt(ctx, e, zero); break;
-          case ops::GE:  pred = yices_mk_ge(ctx, e, zero); break;
-          default:
-                         fprintf(stderr, "Unknown comparison operator: %d\n", (*i)->op());
-                         exit(1);
+    const map<var_t,value_t>* prev = &soln;
+    while (models->size() < num_models) {
+      // Block the previous model: some variable must differ from it.
+      vector<yices_expr> diff;
+      for (map<var_t,value_t>::const_iterator i = prev->begin(); i != prev->end(); ++i) {
+        map<var_t,yices_expr>::const_iterator x = x_expr.find(i->first);
+        if (x != x_expr.end())
+          diff.push_back(MakeVarCompare(ctx, ops::NEQ, x->second,
+                                        vars.find(i->first)->second, i->second));
+      }
+      if (diff.empty())
+        break;
+      yices_assert(ctx, yices_mk_or(ctx, &diff.front(), diff.size()));
+
+      // Try to push a random variable a random distance away from its
+      // previous value, so that the models do not just count upwards.
+      map<var_t,type_t>::const_iterator v = vars.begin();
+      std::advance(v, rand() % vars.size());
+      value_t old_val = prev->find(v->first)->second;
+      value_t dist = 1 + rand() % 256;
+      bool up = (rand() % 2 == 0);
+      bool found = false;
+      if (up ? (old_val <= kMaxValue[v->second] - dist)
+             : (old_val >= kMinValue[v->second] + dist)) {
+        yices_push(ctx);
+        yices_assert(ctx, MakeVarCompare(ctx, up ? ops::GE : ops::LE,
+                                         x_expr[v->first], v->second,
+                                         up ? old_val + dist : old_val - dist));
+        if (yices_check(ctx) == l_true) {
+          models->push_back(map<var_t,value_t>());
+          GetModel(ctx, vars, x_decl, &models->back());
+          found = true;
         }
-        yices_assert(ctx, pred);
+        yices_pop(ctx);
+      }
+      if (!found) {
+        if (yices_check(ctx) != l_true)
+          break;
+        models->push_back(map<var_t,value_t>());
+        GetModel(ctx, vars, x_decl, &models->back());
       }
+      prev = &models->back();
     }
 
-    bool success = (yices_check(ctx) == l_true);
-    if (success) {
-      soln->clear();
-      yices_model model = yices_get_model(ctx);
-      for (VarIt i = vars.begin(); i != vars.end(); ++i) {
-        long val;
-        assert(yices_get_int_value(model, x_decl[i->first], &val));
-        soln->insert(make_pair(i->first, val));
+    yices_del_context(ctx);
+  }
+
+
+  bool YicesSolver::TimedSolve(const map<var_t,type_t>& vars,
+      const vector<const SymbolicPred*>& constraints,
+      map<var_t,value_t>* soln,
+      bool* timed_out) {
+    *timed_out = false;
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      return Solve(vars, constraints, soln);
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == -1) {
+      perror("fork");
+      close(fds[0]);
+      close(fds[1]);
+      return Solve(vars, constraints, soln);
+    }
+
+    if (pid == 0) {
+      // Reply: a status byte, the number of values, then (var, value) pairs.
+      close(fds[0]);
+      map<var_t,value_t> child_soln;
+      bool sat = Solve(vars, constraints, &child_soln);
+      string reply(1, sat ? 1 : 0);
+      size_t n = child_soln.size();
+      reply.append((const char*)&n, sizeof(n));
+      for (map<var_t,value_t>::const_iterator i = child_soln.begin();
+           i != child_soln.end(); ++i) {
+        reply.append((const char*)&i->first, sizeof(var_t));
+        reply.append((const char*)&i->second, sizeof(value_t));
       }
+      WriteAll(fds[1], reply.data(), reply.size());
+      _exit(0);
     }
 
-    yices_del_context(ctx);
-    return success;
+    close(fds[1]);
+    string reply;
+    *timed_out = !ReadChild(fds[0], pid, &reply);
+
+    soln->clear();
+    if (*timed_out)
+      return false;
+
+    const size_t kPairSize = sizeof(var_t) + sizeof(value_t);
+    size_t n = 0;
+    if (reply.size() >= 1 + sizeof(n))
+      memcpy(&n, reply.data() + 1, sizeof(n));
+    if ((reply.size() < 1 + sizeof(n))
+        || (reply.size() != 1 + sizeof(n) + n * kPairSize)) {
+      fprintf(stderr, "Solver child died.\n");
+      *timed_out = true;
+      return false;
+    }
+    const char* p = reply.data() + 1 + sizeof(n);
+    for (size_t i = 0; i < n; i++, p += kPairSize) {
+      var_t var;
+      value_t val;
+      memcpy(&var, p, sizeof(var));
+      memcpy(&val, p + sizeof(var), sizeof(val));
+      soln->insert(soln->end(), make_pair(var, val));
+    }
+    return (reply[0] != 0);
+  }
+
+
+  void YicesSolver::TimedModels(const map<var_t,type_t>& vars,
+      const vector<const SymbolicPred*>& constraints,
+      const map<var_t,value_t>& soln,
+      size_t num_models,
+      vector< map<var_t,value_t> >* models,
+      bool* timed_out) {
+    *timed_out = false;
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      return;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == -1) {
+      perror("fork");
+      close(fds[0]);
+      close(fds[1]);
+      return;
+    }
+
+    if (pid == 0) {
+      // Reply: the number of models, then for each the number of values
+      // and the (var, value) pairs.
+      close(fds[0]);
+      vector< map<var_t,value_t> > child_models;
+      FindModels(vars, constraints, soln, num_models, &child_models);
+      size_t m = child_models.size();
+      string reply((const char*)&m, sizeof(m));
+      for (size_t i = 0; i < m; i++) {
+        size_t n = child_models[i].size();
+        reply.append((const char*)&n, sizeof(n));
+        for (map<var_t,value_t>::const_iterator j = child_models[i].begin();
+             j != child_models[i].end(); ++j) {
+          reply.append((const char*)&j->first, sizeof(var_t));
+          reply.append((const char*)&j->second, sizeof(value_t));
+        }
+      }
+      WriteAll(fds[1], reply.data(), reply.size());
+      _exit(0);
+    }
+
+    close(fds[1]);
+    string reply;
+    if (!ReadChild(fds[0], pid, &reply)) {
+      *timed_out = true;
+      return;
+    }
+
+    // A short or malformed reply means the child died: keep no models.
+    const size_t kPairSize = sizeof(var_t) + sizeof(value_t);
+    const char* p = reply.data();
+    const char* end = p + reply.size();
+    size_t m = 0;
+    if (end - p < (ptrdiff_t)sizeof(m))
+      return;
+    memcpy(&m, p, sizeof(m));
+    p += sizeof(m);
+    vector< map<var_t,value_t> > read_models;
+    for (size_t i = 0; i < m; i++) {
+      size_t n = 0;
+      if (end - p < (ptrdiff_t)sizeof(n))
+        return;
+      memcpy(&n, p, sizeof(n));
+      p += sizeof(n);
+      if ((size_t)(end - p) / kPairSize < n)
+        return;
+      read_models.push_back(map<var_t,value_t>());
+      for (size_t j = 0; j < n; j++, p += kPairSize) {
+        var_t var;
+        value_t val;
+        memcpy(&var, p, sizeof(var));
+        memcpy(&val, p + sizeof(var), sizeof(val));
+        read_models.back().insert(read_models.back().end(), make_pair(var, val));
+      }
+    }
+    if (p == end)
+      models->swap(read_models);
   }
 
 
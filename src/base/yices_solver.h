@@ -12,29 +12,232 @@
 #define BASE_YICES_SOLVER_H__
 
 #include <map>
+#include <string>
 #include <vector>
 
 #include "base/basic_types.h"
+#include "base/symbolic_execution.h"
 #include "base/symbolic_predicate.h"
 
 using std::map;
+using std::string;
 using std::vector;
 
 namespace crest {
 
+// Number of queries answered, and the wall-clock time spent answering
+// them, in each solving mode.
+struct SolverStats {
+  SolverStats()
+    : num_independent_solves(0), independent_secs(0.0),
+      num_session_solves(0), session_secs(0.0),
+      num_cache_lookups(0), num_exact_hits(0), num_persistent_hits(0),
+      num_unsat_subset_hits(0), num_model_hits(0),
+      num_fast_sat(0), num_fast_unsat(0), num_fast_unknown(0),
+      fast_secs(0.0), num_timeouts(0),
+      num_windowed_solves(0), num_window_dropped(0) { }
+
+  unsigned num_independent_solves;
+  double independent_secs;
+  unsigned num_session_solves;
+  double session_secs;
+
+  unsigned num_cache_lookups;
+  unsigned num_exact_hits;
+  unsigned num_persistent_hits;
+  unsigned num_unsat_subset_hits;
+  unsigned num_model_hits;
+
+  // Queries the fast path answered (SAT or UNSAT) or passed on to Yices.
+  unsigned num_fast_sat;
+  unsigned num_fast_unsat;
+  unsigned num_fast_unknown;
+  double fast_secs;
+
+  // Queries abandoned at the timeout (counted as independent solves).
+  unsigned num_timeouts;
+
+  // Queries cut down to the window, and the constraints they left out.
+  unsigned num_windowed_solves;
+  unsigned num_window_dropped;
+
+  // Adds the counts and times of 's' (e.g. from another process).
+  void Add(const SolverStats& s) {
+    num_independent_solves += s.num_independent_solves;
+    independent_secs += s.independent_secs;
+    num_session_solves += s.num_session_solves;
+    session_secs += s.session_secs;
+    num_cache_lookups += s.num_cache_lookups;
+    num_exact_hits += s.num_exact_hits;
+    num_persistent_hits += s.num_persistent_hits;
+    num_unsat_subset_hits += s.num_unsat_subset_hits;
+    num_model_hits += s.num_model_hits;
+    num_fast_sat += s.num_fast_sat;
+    num_fast_unsat += s.num_fast_unsat;
+    num_fast_unknown += s.num_fast_unknown;
+    fast_secs += s.fast_secs;
+    num_timeouts += s.num_timeouts;
+    num_windowed_solves += s.num_windowed_solves;
+    num_window_dropped += s.num_window_dropped;
+  }
+};
+
+// An answer added to the solver cache, under its SolverCache key.
+struct CachedAnswer {
+  vector<hash_t> key;
+  bool sat;
+  map<var_t,value_t> soln;
+};
+
 class YicesSolver {
  public:
+  // By default every query is solved in a fresh Yices context
+  // ("independent" mode).  With the session enabled, IncrementalSolve
+  // instead keeps one context alive, asserts path constraints in path
+  // order (one push level per constraint), and checks each negated
+  // branch under an extra push/pop.  Queries that share a prefix with
+  // the previous one -- sibling negations of the same execution, or an
+  // execution and its children -- then only assert the new suffix.  A
+  // query falls back to independent mode when the session would have to
+  // assert more constraints than the dependent slice contains.
+  static void EnableSession(bool enable);
+
+  // Puts a SolverCache in front of the solver in IncrementalSolve.
+  static void EnableCache(bool enable);
+
+  // Tries FastSolver on each cache miss before calling Yices.
+  static void EnableFastSolver(bool enable);
+
+  // Encodes variables as bit-vectors of their types' widths, and
+  // constraints in value_t's wrap-around arithmetic, instead of as
+  // unbounded integers.  Models then respect overflow the way the
+  // recorded expressions do.  Each constraint is built at the narrowest
+  // width that gives the same values, with its variables sign- or
+  // zero-extended to it.  The constraints must be recorded as the program
+  // compared them, not normalized (see
+  // SymbolicInterpreter::set_normalize).  The session is bypassed, and
+  // fast-path UNSAT answers are not trusted, in this mode.  Call before
+  // EnablePersistentCache.
+  static void EnableBitVectors(bool enable);
+
+  // Solves each query that reaches Yices in a forked child, which is
+  // killed after 'secs' seconds (0, the default, for no limit).  A query
+  // that times out is answered as unsatisfiable but is not cached.  The
+  // session is bypassed while a timeout is set, since the child's
+  // assertions would be lost with it.
+  static void SetTimeout(double secs);
+
+  // Solves only the last 'n' constraints of each dependent slice in
+  // IncrementalSolve(ex, idx, ...) -- always including the negated one --
+  // and lets the other slice variables keep their old values (0, the
+  // default, for the whole slice).  This is approximate: UNSAT answers
+  // still hold, but a model may violate a left-out constraint, which
+  // shows up as a prediction failure.  Truncated queries bypass the
+  // session.
+  static void SetWindow(size_t n);
+
+  // Enables the cache and backs it with a file in 'dir' shared by all
+  // runs on 'program' (see SolverCache::OpenPersistent).
+  static bool EnablePersistentCache(const string& dir, const string& program);
+
+  // Appends every query IncrementalSolve answers -- its dependent slice,
+  // the previous values, the answer, the tier that gave it, and the time
+  // taken -- to the binary query log 'file' (see QueryLog), for replay
+  // by tools/bench_solver.
+  static bool EnableQueryLog(const string& file);
+
+  static const SolverStats& stats() { return stats_; }
+
+  // Support for solving in a forked worker, whose statistics and cache
+  // would otherwise die with it: the worker resets its statistics and
+  // records the answers it caches (in '*answers', until called with
+  // NULL), and the parent adds both to its own.
+  static void ResetStats() { stats_ = SolverStats(); }
+  static void AddStats(const SolverStats& s) { stats_.Add(s); }
+  static void RecordCachedAnswers(vector<CachedAnswer>* answers);
+  static void AddCachedAnswer(const CachedAnswer& answer);
+
   static bool IncrementalSolve(const vector<value_t>& old_soln,
 			       const map<var_t,type_t>& vars,
                                const vector<const SymbolicPred*>& constraints,
 			       map<var_t,value_t>* soln);
 
+  // Solves the path constraints of 'ex' up to and including the 'idx'-th,
+  // which the caller has negated in place.  Like IncrementalSolve above,
+  // only the dependent slice is solved, but it is read off ex.slices()
+  // instead of being recomputed.  'soln' receives values for the slice's
+  // variables only.  '*windowed' (if given) is set to whether only the
+  // window of the slice was solved (see SetWindow).
+  static bool IncrementalSolve(const SymbolicExecution& ex,
+                               size_t idx,
+                               map<var_t,value_t>* soln,
+                               bool* windowed = NULL);
+
+  // Finds up to 'num_models' further solutions of the query that
+  // IncrementalSolve(ex, idx, ...) answered with 'soln' (the caller has
+  // negated the 'idx'-th constraint in place again).  All come from one
+  // fresh context: each model is blocked before asking for the next, and
+  // a random variable is first pushed a random distance away from its
+  // last value, so that the models are spread out.  Under a timeout (see
+  // SetTimeout) the search runs in a child process, and finds nothing if
+  // it does not finish in time.
+  static void ExtraModels(const SymbolicExecution& ex,
+                          size_t idx,
+                          const map<var_t,value_t>& soln,
+                          size_t num_models,
+                          vector< map<var_t,value_t> >* models);
+
   static bool Solve(const map<var_t,type_t>& vars,
                     const vector<const SymbolicPred*>& constraints,
 		    map<var_t,value_t>* soln);
 
   static bool ReadSolutionFromFileOrDie(const string& file,
                                         map<var_t,value_t>* soln);
+
+ private:
+  // Solves a dependent slice of the path prefix constraints[0..n), where
+  // n = 'num_constraints' may be 0 if the slice has no such prefix.
+  static bool SolveSlice(const vector<value_t>& old_soln,
+                         const map<var_t,type_t>& vars,
+                         const SymbolicPred* const* constraints,
+                         size_t num_constraints,
+                         const map<var_t,type_t>& dependent_vars,
+                         const vector<const SymbolicPred*>& dependent_constraints,
+                         map<var_t,value_t>* soln);
+
+  static bool SessionSolve(const map<var_t,type_t>& vars,
+                           const SymbolicPred* const* constraints,
+                           size_t num_constraints,
+                           const map<var_t,type_t>& dependent_vars,
+                           size_t num_dependent_constraints,
+                           map<var_t,value_t>* soln,
+                           bool* success);
+
+  // Solve, but in a child process subject to the timeout.  Sets
+  // '*timed_out' if the child did not answer in time.
+  static bool TimedSolve(const map<var_t,type_t>& vars,
+                         const vector<const SymbolicPred*>& constraints,
+                         map<var_t,value_t>* soln,
+                         bool* timed_out);
+
+  // The model search of ExtraModels, in one fresh context.
+  static void FindModels(const map<var_t,type_t>& vars,
+                         const vector<const SymbolicPred*>& constraints,
+                         const map<var_t,value_t>& soln,
+                         size_t num_models,
+                         vector< map<var_t,value_t> >* models);
+
+  // FindModels, but in a child process subject to the timeout.  Sets
+  // '*timed_out' (and finds no models) if the child did not answer in
+  // time.
+  static void TimedModels(const map<var_t,type_t>& vars,
+                          const vector<const SymbolicPred*>& constraints,
+                          const map<var_t,value_t>& soln,
+                          size_t num_models,
+                          vector< map<var_t,value_t> >* models,
+                          bool* timed_out);
+
+  static SolverStats stats_;
 };
 
 }  // namespace crest
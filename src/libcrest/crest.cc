@@ -10,6 +10,7 @@
 
 #include <assert.h>
 #include <fstream>
+#include <stdlib.h>
 #include <string>
 #include <sys/time.h>
 #include <vector>
@@ -65,6 +66,9 @@ void __CrestInit() {
   in.close();
 
   SI = new SymbolicInterpreter(input);
+  // Set by run_crest when its solver needs the predicates as compared.
+  if (getenv("CREST_EXACT_PREDICATES"))
+    SI->set_normalize(false);
 
   pre_symbolic = 1;
 
@@ -189,3 +193,61 @@ void __CrestInt(int* x) {
   pre_symbolic = 0;
   *x = (int)SI->NewInput(types::INT, (addr_t)x);
 }
+
+
+//
+// Symbolic buffers.
+//
+
+template <typename T>
+static void MakeSymbolicBuffer(T* x, size_t n, type_t type, bool keep) {
+  vector<value_t> initial;
+  if (keep) {
+    initial.assign(x, x + n);
+  }
+
+  pre_symbolic = 0;
+  var_t first = SI->NewInputBuffer(type, (addr_t)x, n,
+                                   keep ? &initial.front() : NULL);
+
+  const vector<value_t>& inputs = SI->execution().inputs();
+  for (size_t i = 0; i < n; i++) {
+    x[i] = (T)inputs[first + i];
+  }
+}
+
+void __CrestBuffer(void* x, __CREST_SIZE n, __CREST_TYPE type) {
+  if (n == 0)
+    return;
+
+  switch (type) {
+  case types::U_CHAR:
+    MakeSymbolicBuffer((unsigned char*)x, n, types::U_CHAR, false); break;
+  case types::CHAR:
+    MakeSymbolicBuffer((char*)x, n, types::CHAR, false); break;
+  case types::U_SHORT:
+    MakeSymbolicBuffer((unsigned short*)x, n, types::U_SHORT, false); break;
+  case types::SHORT:
+    MakeSymbolicBuffer((short*)x, n, types::SHORT, false); break;
+  case types::U_INT:
+    MakeSymbolicBuffer((unsigned int*)x, n, types::U_INT, false); break;
+  case types::INT:
+    MakeSymbolicBuffer((int*)x, n, types::INT, false); break;
+  case types::U_LONG:
+    MakeSymbolicBuffer((unsigned long*)x, n, types::U_LONG, false); break;
+  case types::LONG:
+    MakeSymbolicBuffer((long*)x, n, types::LONG, false); break;
+  case types::U_LONG_LONG:
+    MakeSymbolicBuffer((unsigned long long*)x, n, types::U_LONG_LONG, false); break;
+  case types::LONG_LONG:
+    MakeSymbolicBuffer((long long*)x, n, types::LONG_LONG, false); break;
+  default:
+    assert(false);
+  }
+}
+
+// Called by the read()/fread() wrappers in libcrest/crest_io.cc.
+void __CrestFileBuffer(void* x, size_t n) {
+  if (SI && (n > 0))
+    MakeSymbolicBuffer((unsigned char*)x, n, types::U_CHAR, true);
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+// Interposition of read() and fread() for symbolic file inputs.
+//
+// These wrappers are only linked in when the program under test is
+// linked with "-Wl,--wrap=read,--wrap=fread" (which is also what makes
+// the __real_ symbols available).  See libcrest/crest.h.
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+void __CrestFileBuffer(void* x, size_t n);
+
+extern "C" {
+ssize_t __real_read(int fd, void* buf, size_t count);
+size_t __real_fread(void* ptr, size_t size, size_t nmemb, FILE* stream);
+ssize_t __wrap_read(int fd, void* buf, size_t count);
+size_t __wrap_fread(void* ptr, size_t size, size_t nmemb, FILE* stream);
+}
+
+namespace {
+
+// The (resolved) paths listed in CREST_SYMBOLIC_FILES.
+vector<string>* symbolic_files = NULL;
+bool symbolic_stdin = false;
+
+void ReadSymbolicFiles() {
+  symbolic_files = new vector<string>();
+  const char* env = getenv("CREST_SYMBOLIC_FILES");
+  if (!env)
+    return;
+
+  string list(env);
+  size_t pos = 0;
+  while (pos <= list.size()) {
+    size_t next = list.find(':', pos);
+    if (next == string::npos)
+      next = list.size();
+    string path = list.substr(pos, next - pos);
+    if (path == "-") {
+      symbolic_stdin = true;
+    } else if (!path.empty()) {
+      char resolved[PATH_MAX];
+      if (realpath(path.c_str(), resolved))
+        symbolic_files->push_back(resolved);
+    }
+    pos = next + 1;
+  }
+}
+
+bool IsSymbolicFile(int fd) {
+  if (!symbolic_files)
+    ReadSymbolicFiles();
+
+  if ((fd == STDIN_FILENO) && symbolic_stdin)
+    return true;
+  if (symbolic_files->empty())
+    return false;
+
+  char link[64], path[PATH_MAX];
+  snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+  ssize_t len = readlink(link, path, sizeof(path) - 1);
+  if (len <= 0)
+    return false;
+  path[len] = '\0';
+
+  for (size_t i = 0; i < symbolic_files->size(); i++) {
+    if ((*symbolic_files)[i] == path)
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+
+ssize_t __wrap_read(int fd, void* buf, size_t count) {
+  ssize_t ret = __real_read(fd, buf, count);
+  if ((ret > 0) && IsSymbolicFile(fd)) {
+    __CrestFileBuffer(buf, ret);
+  }
+  return ret;
+}
+
+size_t __wrap_fread(void* ptr, size_t size, size_t nmemb, FILE* stream) {
+  size_t ret = __real_fread(ptr, size, nmemb, stream);
+  if ((ret > 0) && IsSymbolicFile(fileno(stream))) {
+    __CrestFileBuffer(ptr, ret * size);
+  }
+  return ret;
+}
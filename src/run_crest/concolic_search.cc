@@ -22,9 +22,13 @@
 #include <sstream>
 #include <string>
 #include <numeric>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "base/yices_solver.h"
 #include "run_crest/concolic_search.h"
@@ -50,6 +54,43 @@ namespace {
 
 typedef pair<size_t,int> ScoredBranch;
 
+// Number of static features per branch in the "features" file; the
+// weights of the dynamic features follow theirs.
+const size_t kNumStaticFeatures = 12;
+
+// The fixed threshold (in branches) of the last IsNearUncovered_Function
+// feature; the others follow the search's top 10/20/30% thresholds.
+const int kNearFunctionMinBranches = 10;
+
+// Computes the score of each of 'n' rows: 'base[r]' plus, in feature
+// order, the weight 'w[j]' of every dynamic feature j set in 'bits[r]'.
+// With SSE2, two rows are scored at once, one per lane.  Each lane adds
+// the same terms in the same order as the scalar loop (and as
+// inner_product over the unpacked row), so the scores are bit-identical
+// on either path.
+void ScoreRows(const double* base, const uint64_t* bits, size_t n,
+               const double* w, size_t num_w, double* out) {
+  size_t r = 0;
+#ifdef __SSE2__
+  for (; r + 2 <= n; r += 2) {
+    __m128d acc = _mm_loadu_pd(base + r);
+    const uint64_t b0 = bits[r], b1 = bits[r + 1];
+    for (size_t j = 0; j < num_w; j++) {
+      __m128i mask = _mm_set_epi64x(-static_cast<long long>((b1 >> j) & 1),
+                                    -static_cast<long long>((b0 >> j) & 1));
+      acc = _mm_add_pd(acc, _mm_and_pd(_mm_castsi128_pd(mask), _mm_set1_pd(w[j])));
+    }
+    _mm_storeu_pd(out + r, acc);
+  }
+#endif
+  for (; r < n; r++) {
+    double acc = base[r];
+    for (size_t j = 0; j < num_w; j++)
+      acc += w[j] * static_cast<double>((bits[r] >> j) & 1);
+    out[r] = acc;
+  }
+}
+
 struct ScoredBranchComp
 : public binary_function<ScoredBranch, ScoredBranch, bool>
 {
@@ -67,8 +108,33 @@ struct ScoredBranchComp
 
 Search::Search(const string& program, const string& input_file,
     const string& log_file, int max_iterations, int max_time) :
+  top10_threshold_(0),
+  top20_threshold_(0),
+  top30_threshold_(0),
+  thresholds_stale_(true),
   num_smt_unsat_(0),
   num_smt_try_(0),
+  num_prediction_checks_(0),
+  num_prediction_failures_(0),
+  num_execs_(0),
+  num_repeated_constraints_(0),
+  max_branch_cost_(0.0),
+  num_models_(1),
+  num_extra_models_(0),
+  num_model_retries_(0),
+  num_model_retry_hits_(0),
+  min_window_(0),
+  window_(0),
+  max_window_(0),
+  window_check_pending_(false),
+  windowed_branch_idx_(0),
+  num_window_hits_(0),
+  num_window_checks_(0),
+  num_window_failures_(0),
+  check_features_(false),
+  row_pool_(NULL),
+  feature_min_rows_(0),
+  solver_pool_(NULL),
   program_(program),
   input_file_(input_file),
 	log_file_(log_file),
@@ -89,6 +155,7 @@ Search::Search(const string& program, const string& input_file,
     assert(in);
     function_id_t fid;
     int numBranches;
+    vector<pair<function_id_t, branch_id_t> > fid_branch_pairs;
     while (in >> fid >> numBranches) {
       branch_count_.push_back(2 * numBranches);
       branch_id_t b1, b2;
@@ -97,13 +164,30 @@ Search::Search(const string& program, const string& input_file,
         branches_.push_back(b1);
         branches_.push_back(b2);
         max_branch_ = max(max_branch_, max(b1, b2));
-	fid_branches_map_[fid].insert(b1);
-	fid_branches_map_[fid].insert(b2);
+	fid_branch_pairs.push_back(make_pair(fid, b1));
+	fid_branch_pairs.push_back(make_pair(fid, b2));
       }
     }
     in.close();
     max_branch_ ++;
     max_function_ = branch_count_.size();
+
+    // Lay out the branches of each function in compressed rows.
+    sort(fid_branch_pairs.begin(), fid_branch_pairs.end());
+    fid_branch_pairs.erase(unique(fid_branch_pairs.begin(), fid_branch_pairs.end()),
+                           fid_branch_pairs.end());
+    function_id_t num_rows = max_function_;
+    if (!fid_branch_pairs.empty())
+      num_rows = max(num_rows, fid_branch_pairs.back().first + 1);
+    fid_branch_begin_.assign(num_rows + 1, 0);
+    fid_branches_.reserve(fid_branch_pairs.size());
+    for (size_t i = 0; i < fid_branch_pairs.size(); i++) {
+      fid_branch_begin_[fid_branch_pairs[i].first + 1]++;
+      fid_branches_.push_back(fid_branch_pairs[i].second);
+    }
+    for (function_id_t f = 0; f < num_rows; f++) {
+      fid_branch_begin_[f + 1] += fid_branch_begin_[f];
+    }
   }
  
   // Compute the paired-branch map.
@@ -123,14 +207,41 @@ Search::Search(const string& program, const string& input_file,
   }
   }
 
+  for (size_t i = 0; i < branches_.size(); i++) {
+    branch_functions_.push_back(branch_function_[branches_[i]]);
+  }
+  sort(branch_functions_.begin(), branch_functions_.end());
+  branch_functions_.erase(unique(branch_functions_.begin(), branch_functions_.end()),
+                          branch_functions_.end());
+
   // Initialize all branches to "uncovered" (and functions to "unreached").
   total_num_covered_ = num_covered_ = 0;
+  init_coverage_ = 0;
   reachable_functions_ = reachable_branches_ = 0;
   covered_.resize(max_branch_, false);
   total_covered_.resize(max_branch_, false);
+  newly_covered_.resize(max_branch_, false);
   reached_.resize(max_function_, false);
+
+  // Every function with branches starts out unreached.  (The functions
+  // are the rows of fid_branch_begin_, which may outnumber max_function_.)
+  size_t max_size = 0;
+  for (size_t i = 0; i < branch_functions_.size(); i++) {
+    function_id_t fid = branch_functions_[i];
+    max_size = max(max_size, fid_branch_begin_[fid + 1] - fid_branch_begin_[fid]);
+  }
+  uncovered_pos_.resize(fid_branch_begin_.size() - 1,
+                        numeric_limits<size_t>::max());
+  uncovered_sizes_.Reset(max_size);
+  for (size_t i = 0; i < branch_functions_.size(); i++) {
+    function_id_t fid = branch_functions_[i];
+    uncovered_pos_[fid] = uncovered_function_id_.size();
+    uncovered_function_id_.push_back(fid);
+    uncovered_sizes_.Insert(fid_branch_begin_[fid + 1] - fid_branch_begin_[fid]);
+  }
   // Remember how many times each bid got UNSAT.
   bid_unsat_count_.resize(max_branch_, 0);
+  branch_solve_stats_.resize(max_branch_);
 
 #if 0
   { // Read in any previous coverage (for faster debugging).
@@ -170,7 +281,11 @@ Search::Search(const string& program, const string& input_file,
 }
 
 
-Search::~Search() { }
+Search::~Search() {
+  delete solver_pool_;
+  DynamicFeature::SetRowPool(NULL);
+  delete row_pool_;
+}
 
 
 void Search::SaveInput(const vector<value_t>& input, const char* str)
@@ -303,6 +418,7 @@ void Search::RunProgram(const vector<value_t>& inputs, SymbolicExecution* ex) {
 */
   // Run the program.
   LaunchProgram(inputs);
+  num_execs_++;
 
   // Read the execution from the program.
   // Want to do this with sockets.  (Currently doing it with files.)
@@ -326,6 +442,7 @@ void Search::RunProgram(const vector<value_t>& inputs,
 		exit(0);
 	}
 	LaunchProgram(inputs, out_file);
+	num_execs_++;
 
   ifstream in("szd_execution", ios::in | ios::binary);
   assert(in && ex->Parse(in));
@@ -349,6 +466,9 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex) {
 bool Search::UpdateCoverage(const SymbolicExecution& ex,
     set<branch_id_t>* new_branches) {
 
+	for (size_t i = 0; i < newly_covered_branches_.size(); i++) {
+		newly_covered_[newly_covered_branches_[i]] = false;
+	}
 	newly_covered_branches_.clear();
 	FILE *f = fopen(log_file_.c_str(), "a");
 	if (!f) {
@@ -363,7 +483,8 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex,
     if ((*i > 0) && !covered_[*i]) {
       covered_[*i] = true;
       num_covered_++;
-			newly_covered_branches_.insert(*i);
+			newly_covered_branches_.push_back(*i);
+			newly_covered_[*i] = true;
       if (new_branches) {
         new_branches->insert(*i);
       }
@@ -371,7 +492,7 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex,
         reached_[branch_function_[*i]] = true;
         reachable_functions_ ++;
         reachable_branches_ += branch_count_[branch_function_[*i]];
-				latest_covered_fid_.insert(branch_function_[*i]);
+				latest_covered_fid_.push_back(branch_function_[*i]);
       }
     }
     if ((*i > 0) && !total_covered_[*i]) {
@@ -380,36 +501,25 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex,
     }
   }
 
-  //Gather Uncovered fun_id 
-  uncovered_function_id_.clear();
-  for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
-  	function_id_t fun_id = branch_function_[*i]; 
-	if(!reached_[fun_id]){
-   		uncovered_function_id_.insert(fun_id);
-	}
-  }
-  //Calcuate uncovered_fid_bidsize and Sort
-  unc_fid_bidsize_.clear();
-  for(auto it = uncovered_function_id_.begin(); it != uncovered_function_id_.end(); ++it){
-	int bid_size = fid_branches_map_[*it].size();
-	unc_fid_bidsize_.push_back(pair<int, function_id_t>(bid_size, *it));
-  }
-  sort(unc_fid_bidsize_.begin(), unc_fid_bidsize_.end());
-  if(unc_fid_bidsize_.size() > 0){ //Handing Exceptional Case. 
-  	size_t top10 = unc_fid_bidsize_.size() /10 ;
-  	size_t top20 = unc_fid_bidsize_.size() /5 ;
-  	size_t top30 = unc_fid_bidsize_.size() /3 ;
-    auto top_it = unc_fid_bidsize_.end();
-    top10_threshold_ = (top_it-top10)->first;
-    top20_threshold_ = (top_it-top20)->first;
-    top30_threshold_ = (top_it-top30)->first;
-  }
-  else{
-  	top10_threshold_ = 0;
-    top20_threshold_ = 0;
-    top30_threshold_ = 0;
-  }		  
+  // Drop the newly reached functions from the uncovered ones.
+  for (size_t i = 0; i < latest_covered_fid_.size(); i++) {
+    function_id_t fid = latest_covered_fid_[i];
+    size_t pos = uncovered_pos_[fid];
+    if (pos == numeric_limits<size_t>::max())
+      continue;
+    uncovered_function_id_[pos] = uncovered_function_id_.back();
+    uncovered_pos_[uncovered_function_id_[pos]] = pos;
+    uncovered_function_id_.pop_back();
+    uncovered_pos_[fid] = numeric_limits<size_t>::max();
+    uncovered_sizes_.Erase(fid_branch_begin_[fid + 1] - fid_branch_begin_[fid]);
+    thresholds_stale_ = true;
+  }
+  if (thresholds_stale_)
+    UpdateFunctionThresholds();
 		   
+  if (num_iters_ == 1)
+    init_coverage_ = total_num_covered_;
+
   fprintf(stderr, "Iteration %d (%lds): covered %u branches [%u reach funs, %u reach branches].\n",
       num_iters_, time(NULL)-start_time_, total_num_covered_, reachable_functions_, reachable_branches_);
 
@@ -428,6 +538,25 @@ bool Search::UpdateCoverage(const SymbolicExecution& ex,
 }
 
 
+void Search::UpdateFunctionThresholds() {
+  // The threshold for the largest p% of the n uncovered functions is the
+  // size of the (n/(100/p))-th largest.  When that is none of them, it
+  // is one above the largest, so that no function qualifies.
+  const size_t n = uncovered_sizes_.size();
+  const size_t top[3] = { n / 10, n / 5, n / 3 };
+  int* thresholds[3] = { &top10_threshold_, &top20_threshold_, &top30_threshold_ };
+  for (size_t i = 0; i < 3; i++) {
+    if (n == 0)
+      *thresholds[i] = 0;
+    else if (top[i] == 0)
+      *thresholds[i] = uncovered_sizes_.Select(n) + 1;
+    else
+      *thresholds[i] = uncovered_sizes_.Select(n - top[i] + 1);
+  }
+  thresholds_stale_ = false;
+}
+
+
 void Search::RandomInput(const map<var_t,type_t>& vars, vector<value_t>* input) {
   input->resize(vars.size());
 
@@ -511,38 +640,165 @@ bool Search::SolveAtBranchNew(const SymbolicExecution& ex, size_t branch_idx,
     constraints[i]->AppendVars(&used_vars);
   }
 
-  set<value_t>::iterator it;
-  for (var_t var = 0; var < input->size(); var++) {
-    if (used_vars.count(var) == 0)
-      (*input)[var] = GetOneRandomInput(ex.vars().find(var)->second);
+  // Inputs are numbered densely, so walk the variables in order rather
+  // than looking each one up.
+  typedef map<var_t,type_t>::const_iterator VarIt;
+  for (VarIt i = ex.vars().begin(); i != ex.vars().end(); ++i) {
+    if ((i->first < input->size()) && (used_vars.count(i->first) == 0))
+      (*input)[i->first] = GetOneRandomInput(i->second);
   }
   return solved;
 }
 
+bool Search::IsRepeatedConstraint(const SymbolicExecution& ex,
+                                  size_t branch_idx) {
+  if (ex.has_first_occurrences())
+    return ex.first_occurrence(branch_idx) != branch_idx;
+
+  const vector<SymbolicPred*>& constraints = ex.path().constraints();
+  for (int i = static_cast<int>(branch_idx) - 1; i >= 0; i--) {
+    if (constraints[branch_idx]->Equal(*constraints[i]))
+      return true;
+  }
+  return false;
+}
+
+double Search::ExpectedSolveCost(branch_id_t bid) const {
+  // Every query costs at least this much, so that branches which are
+  // cheap but always unsatisfiable still become costly.
+  static const double kMinQuerySecs = 0.001;
+  const BranchSolveStats& st = branch_solve_stats_[bid];
+  double mean_secs = (st.num_solves > 0) ? st.secs / st.num_solves : 0.0;
+  double p_sat = (st.num_solves - st.num_failures + 1.0) / (st.num_solves + 2.0);
+  return max(mean_secs, kMinQuerySecs) / p_sat;
+}
+
+bool Search::IsTooCostly(branch_id_t bid) const {
+  if (max_branch_cost_ > 0.0)
+    return ExpectedSolveCost(bid) > max_branch_cost_;
+  return branch_solve_stats_[bid].num_failures > 70;
+}
+
+void Search::SetMaxBranchCost(double secs) {
+  max_branch_cost_ = (secs > 0.0) ? secs : 0.0;
+}
+
+void Search::SetNumModels(size_t n) {
+  num_models_ = (n > 1) ? n : 1;
+}
+
+void Search::SetSolverWindow(size_t n) {
+  min_window_ = window_ = max_window_ = n;
+  YicesSolver::SetWindow(n);
+}
+
+void Search::CheckIncrementalFeatures(bool check) {
+  check_features_ = check;
+}
+
+void Search::SetFeatureThreads(size_t num_threads, size_t min_rows) {
+  DynamicFeature::SetRowPool(NULL);
+  delete row_pool_;
+  row_pool_ = (num_threads > 1) ? new RowPool(num_threads, min_rows) : NULL;
+  feature_min_rows_ = min_rows;
+  DynamicFeature::SetRowPool(row_pool_);
+}
+
+void Search::UpdateWindow(bool prediction_ok) {
+  // Halve the window after this many windowed hits in a row.
+  static const unsigned kShrinkAfter = 8;
+  num_window_checks_++;
+  if (!prediction_ok) {
+    num_window_failures_++;
+    num_window_hits_ = 0;
+    window_ *= 2;
+    max_window_ = max(max_window_, window_);
+  } else if (++num_window_hits_ >= kShrinkAfter) {
+    num_window_hits_ = 0;
+    window_ = max(min_window_, window_ / 2);
+  }
+  YicesSolver::SetWindow(window_);
+}
+
+void Search::DiverseInputs(const SymbolicExecution& ex, size_t branch_idx,
+                           const vector<value_t>& input,
+                           vector< vector<value_t> >* inputs) {
+  inputs->clear();
+  if (num_models_ <= 1)
+    return;
+
+  map<var_t,value_t> soln;
+  for (var_t v = 0; v < input.size(); v++)
+    soln.insert(soln.end(), make_pair(v, input[v]));
+
+  vector< map<var_t,value_t> > models;
+  const vector<SymbolicPred*>& constraints = ex.path().constraints();
+  unsigned num_timeouts = YicesSolver::stats().num_timeouts;
+  constraints[branch_idx]->Negate();
+  YicesSolver::ExtraModels(ex, branch_idx, soln, num_models_ - 1, &models);
+  constraints[branch_idx]->Negate();
+  num_extra_models_ += models.size();
+  if (YicesSolver::stats().num_timeouts != num_timeouts) {
+    branch_id_t bid = ex.path().branches()[ex.path().constraints_idx()[branch_idx]];
+    branch_solve_stats_[bid].num_timeouts++;
+  }
+
+  typedef map<var_t,value_t>::const_iterator SolnIt;
+  for (size_t i = 0; i < models.size(); i++) {
+    inputs->push_back(input);
+    for (SolnIt j = models[i].begin(); j != models[i].end(); ++j)
+      inputs->back()[j->first] = j->second;
+  }
+}
+
+void Search::EnableSolverPool(size_t num_workers) {
+  delete solver_pool_;
+  solver_pool_ = (num_workers > 1) ? new SolverPool(num_workers) : NULL;
+}
+
 bool Search::SolveAtBranch(const SymbolicExecution& ex,
                            size_t branch_idx,
                            vector<value_t>* input) {
 
   num_smt_try_++;
   const vector<SymbolicPred*>& constraints = ex.path().constraints();
+  branch_id_t bid = ex.path().branches()[ex.path().constraints_idx()[branch_idx]];
+  BranchSolveStats& bst = branch_solve_stats_[bid];
+  bst.num_solves++;
 
   // Optimization: If any of the previous constraints are idential to the
   // branch_idx-th constraint, immediately return false.
-  for (int i = static_cast<int>(branch_idx) - 1; i >= 0; i--) {
-    if (constraints[branch_idx]->Equal(*constraints[i])) {
-      num_smt_unsat_++;
-      return false;
-    }
+  if (IsRepeatedConstraint(ex, branch_idx)) {
+    num_repeated_constraints_++;
+    num_smt_unsat_++;
+    bst.num_failures++;
+    return false;
   }
 
-  vector<const SymbolicPred*> cs(constraints.begin(),
-         constraints.begin()+branch_idx+1);
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  unsigned num_timeouts = YicesSolver::stats().num_timeouts;
   map<var_t,value_t> soln;
-  constraints[branch_idx]->Negate();
-  // fprintf(stderr, "Yices . . . ");
-  bool success = YicesSolver::IncrementalSolve(ex.inputs(), ex.vars(), cs, &soln);
-  // fprintf(stderr, "%d\n", success);
-  constraints[branch_idx]->Negate();
+  bool success;
+  bool windowed = false;
+  // A pooled answer is charged the worker's solve time, not the wait.
+  double solve_secs = 0.0;
+  bool pooled = solver_pool_ && solver_pool_->Pending(ex, branch_idx)
+      && solver_pool_->Wait(ex, branch_idx, &success, &soln, &windowed,
+                            &solve_secs);
+  if (!pooled) {
+    constraints[branch_idx]->Negate();
+    // fprintf(stderr, "Yices . . . ");
+    success = YicesSolver::IncrementalSolve(ex, branch_idx, &soln, &windowed);
+    // fprintf(stderr, "%d\n", success);
+    constraints[branch_idx]->Negate();
+  }
+  gettimeofday(&end, NULL);
+  if (!pooled)
+    solve_secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+  bst.secs += solve_secs;
+  if (YicesSolver::stats().num_timeouts != num_timeouts)
+    bst.num_timeouts++;
 
   if (success) {
     // Merge the solution with the previous input to get the next
@@ -554,11 +810,17 @@ bool Search::SolveAtBranch(const SymbolicExecution& ex,
     for (SolnIt i = soln.begin(); i != soln.end(); ++i) {
       (*input)[i->first] = i->second;
     }
+    // An approximate model: the prediction check of the execution on
+    // this input resizes the window.
+    if (windowed) {
+      window_check_pending_ = true;
+      windowed_input_ = *input;
+      windowed_branch_idx_ = ex.path().constraints_idx()[branch_idx];
+    }
     return true;
   }
   num_smt_unsat_++;
-  branch_id_t bid;
-  bid = ex.path().branches()[ex.path().constraints_idx()[branch_idx]];
+  bst.num_failures++;
   bid_unsat_count_[paired_branch_[bid]]++;
 
   return false;
@@ -595,22 +857,42 @@ bool Search::SolveAtBranchOnly(const SymbolicExecution& ex,
   return false;
 }
 
+bool Search::BranchFlipped(const SymbolicExecution& old_ex,
+                           const SymbolicExecution& new_ex,
+                           size_t branch_idx) const {
+  bool ok = (old_ex.path().branches().size() > branch_idx)
+            && (new_ex.path().branches().size() > branch_idx);
+
+   for (size_t j = 0; ok && (j < branch_idx); j++) {
+     if  (new_ex.path().branches()[j] != old_ex.path().branches()[j])
+       ok = false;
+   }
+   if (ok) {
+     ok = (new_ex.path().branches()[branch_idx]
+           == paired_branch_[old_ex.path().branches()[branch_idx]]);
+   }
+   return ok;
+}
+
 bool Search::CheckPrediction(const SymbolicExecution& old_ex,
            const SymbolicExecution& new_ex,
            size_t branch_idx) {
 
-  if ((old_ex.path().branches().size() <= branch_idx)
-      || (new_ex.path().branches().size() <= branch_idx)) {
-    return false;
-  }
-
-   for (size_t j = 0; j < branch_idx; j++) {
-     if  (new_ex.path().branches()[j] != old_ex.path().branches()[j]) {
-       return false;
-     }
+  num_prediction_checks_++;
+  bool ok = BranchFlipped(old_ex, new_ex, branch_idx);
+   if (!ok)
+     num_prediction_failures_++;
+
+   // (The program may have read further, random inputs.)
+   const vector<value_t>& inputs = new_ex.inputs();
+   if (window_check_pending_ && (branch_idx == windowed_branch_idx_)
+       && (inputs.size() >= windowed_input_.size())
+       && std::equal(windowed_input_.begin(), windowed_input_.end(),
+                     inputs.begin())) {
+     window_check_pending_ = false;
+     UpdateWindow(ok);
    }
-   return (new_ex.path().branches()[branch_idx]
-           == paired_branch_[old_ex.path().branches()[branch_idx]]);
+   return ok;
 }
 
 void Search::PrintFinalResult()
@@ -623,6 +905,9 @@ void Search::PrintFinalResult()
 
   fprintf(stderr, "NumSMTUNSAT:  %u / %u \n",
       num_smt_unsat_, num_smt_try_);
+  PrintPredictionStats(stderr);
+  PrintSolverStats(stderr);
+  PrintStrategyStats(stderr);
 
   fprintf(stderr, "Covered Branches: ");
   for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
@@ -638,11 +923,22 @@ void Search::PrintFinalResult()
     if (bid_unsat_count_[*i] > 0)
       fprintf(stderr, "%d:%d ", *i, bid_unsat_count_[*i]);
   }
+  fprintf(stderr, "\n");
+
+  fprintf(stderr, "Branch Solve Time: ");
+  for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
+    const BranchSolveStats& st = branch_solve_stats_[*i];
+    if (st.num_solves > 0)
+      fprintf(stderr, "%d:%u/%.3lf ", *i, st.num_solves, st.secs);
+  }
   fprintf(stderr, "\n");
 
 	// Write the final result to the log file
 	fprintf(f, "NumSMTUNSAT:  %u / %u \n",
       num_smt_unsat_, num_smt_try_);
+  PrintPredictionStats(f);
+  PrintSolverStats(f);
+  PrintStrategyStats(f);
 
   fprintf(f, "Covered Branches: ");
   for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
@@ -657,6 +953,14 @@ void Search::PrintFinalResult()
     if (bid_unsat_count_[*i] > 0)
       fprintf(f, "%d:%d ", *i, bid_unsat_count_[*i]);
   }
+  fprintf(f, "\n");
+
+  fprintf(f, "Branch Solve Time: ");
+  for (BranchIt i = branches_.begin(); i != branches_.end(); ++i) {
+    const BranchSolveStats& st = branch_solve_stats_[*i];
+    if (st.num_solves > 0)
+      fprintf(f, "%d:%u/%.3lf ", *i, st.num_solves, st.secs);
+  }
   fprintf(f, "\n");
 	
 	fclose(f);
@@ -664,10 +968,69 @@ void Search::PrintFinalResult()
   WriteCoverageFunToFileOrDie("covered_functions");
   WriteCoverageToFileOrDie("covered_branches");
 }
+void Search::PrintPredictionStats(FILE* f)
+{
+  // Executions after the first, whose coverage is the baseline.
+  unsigned num_execs = (num_execs_ > 0) ? num_execs_ - 1 : 0;
+  unsigned num_new = total_num_covered_ - init_coverage_;
+  fprintf(f, "Prediction failures: %u / %u\n",
+      num_prediction_failures_, num_prediction_checks_);
+  fprintf(f, "Executions per new branch: %.2lf (%u executions, %u new branches)\n",
+      num_new > 0 ? static_cast<double>(num_execs) / num_new : 0.0,
+      num_execs, num_new);
+}
+
+void Search::PrintSolverStats(FILE* f)
+{
+  const SolverStats& st = YicesSolver::stats();
+  fprintf(f, "Solver: independent %u solves in %.3lfs (%.1lf/s), "
+      "session %u solves in %.3lfs (%.1lf/s)\n",
+      st.num_independent_solves, st.independent_secs,
+      st.independent_secs > 0 ? st.num_independent_solves / st.independent_secs : 0.0,
+      st.num_session_solves, st.session_secs,
+      st.session_secs > 0 ? st.num_session_solves / st.session_secs : 0.0);
+  fprintf(f, "Solver repeated constraints: %u rejected without a query\n",
+      num_repeated_constraints_);
+  if (st.num_fast_sat + st.num_fast_unsat + st.num_fast_unknown > 0) {
+    fprintf(f, "Solver fast path: %u sat, %u unsat, %u passed to Yices, in %.3lfs\n",
+        st.num_fast_sat, st.num_fast_unsat, st.num_fast_unknown, st.fast_secs);
+  }
+  if (st.num_timeouts > 0) {
+    fprintf(f, "Solver timeouts: %u\n", st.num_timeouts);
+  }
+  if (num_models_ > 1) {
+    fprintf(f, "Solver models: %u extra models, %u retried, %u flipped the branch\n",
+        num_extra_models_, num_model_retries_, num_model_retry_hits_);
+  }
+  if (min_window_ > 0) {
+    fprintf(f, "Solver window: %u queries truncated (%u constraints left out), "
+        "%u / %u prediction failures, window %zu (largest %zu)\n",
+        st.num_windowed_solves, st.num_window_dropped,
+        num_window_failures_, num_window_checks_, window_, max_window_);
+  }
+  if (solver_pool_) {
+    fprintf(f, "Solver pool: %zu workers, %u queries started, %u answers used, "
+        "%.3lfs waiting\n",
+        solver_pool_->num_workers(), solver_pool_->num_started(),
+        solver_pool_->num_collected(), solver_pool_->wait_secs());
+  }
+  if (st.num_cache_lookups > 0) {
+    double n = st.num_cache_lookups / 100.0;
+    fprintf(f, "Solver cache: %u lookups, exact %.1lf%%, persistent %.1lf%%, "
+        "unsat-subset %.1lf%%, model reuse %.1lf%%\n",
+        st.num_cache_lookups, st.num_exact_hits / n, st.num_persistent_hits / n,
+        st.num_unsat_subset_hits / n, st.num_model_hits / n);
+  }
+}
+
 int Search::GetNumIters()
 {
 	return num_iters_;
 }
+
+bool Search::BudgetLeft() const {
+	return (num_iters_ < max_iters_) && ((time(NULL)-start_time_) <= max_time_);
+}
 ////////////////////////////////////////////////////////////////////////
 //// BoundedDepthFirstSearch ///////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -1369,6 +1732,13 @@ bool CfgHeuristicSearch::DoSearch(int depth,
       scoredBranches[i].second = dist_[bid] + seen[bid];
       seen[bid] += 1;
 
+      // With a cost limit, push expensive branches one step further away
+      // per multiple of the limit.
+      if (max_branch_cost_ > 0.0) {
+        double cost = ExpectedSolveCost(prev_ex.path().branches()[branch_idx]);
+        scoredBranches[i].second += static_cast<int>(min(cost / max_branch_cost_, 1000.0));
+      }
+
       /*
       if (dist_[bid] == 0) {
         scoredBranches[i].second = 0;
@@ -1761,60 +2131,20 @@ bool CGSSymbolicExecution::Tried(int cidx) {
   return tried_[cidx];
 }
 
-vector<branch_id_t> CGSSymbolicExecution::GetContext(int cidx, size_t k, map< branch_id_t, set<branch_id_t> > &dominator) {
-	vector<branch_id_t> context;
-	const vector<branch_id_t>& branches = path().branches();
-	const vector<size_t>& cidxs = path().constraints_idx();
-
-	int bidx = cidxs[cidx];
-	branch_id_t bid = branches[bidx];
-  	set<branch_id_t> dom = dominator[bid];
-
-  	context.push_back(bid);
-  	bidx--;
-
-  	while (bidx >= 0) {
-    	if (context.size() >= k) 
-     		break;
-    	if (dom.count(branches[bidx]) == 0)
-      		context.push_back(branches[bidx]);
-    	bidx--;
-  	}
-  	return context;
-/*  original CGS
-  vector<branch_id_t> context;
-  vector<branch_id_t> branches = path().branches();
-
-  int bidx = path().constraints_idx()[cidx];
-  branch_id_t bid = branches[bidx];
-  set<branch_id_t> dom = dominator[bid];
-
-  context.push_back(bid);
-  bidx--;
-
-  while (bidx >= 0) {
-    if (context.size() >= k) 
-      break;
-    if (dom.count(branches[bidx]) == 0)
-      context.push_back(branches[bidx]);
-    bidx--;
-  }
-  return context;
-*/
-}
-
 ContextGuidedSearch::ContextGuidedSearch(
     const string& program,
 		const string& input_file,
 		const string& log_file,
 		int max_iterations, int max_time, int max_k,
 		const string& dom_file)
-  : Search(program, input_file, log_file, max_iterations, max_time), max_k_(max_k) {
+  : Search(program, input_file, log_file, max_iterations, max_time), max_k_(max_k),
+    context_index_(max_k > 0 ? max_k : 1) {
     ex_tree_.reserve(max_iterations);
 
     // Read in dominator and save. (if it is given)
 		if (!dom_file.empty())
 			ReadDominator(dom_file, dominator_);
+		context_index_.SetDominators(dominator_);
 }
 
 
@@ -1863,7 +2193,7 @@ void ContextGuidedSearch::DoCGS() {
   ex_tree_.clear();
   // Clear context cache or not?
   // While testing grep with optional arguments, do not clear.
-  context_cache_.clear();
+  context_cache_.Clear();
 
   int ex_no = 0;
   size_t k = 1;
@@ -1888,11 +2218,11 @@ void ContextGuidedSearch::DoCGS() {
       for (vector<int>::iterator it = exs_at_depth.begin(); it != exs_at_depth.end(); ++it) {
         prev_ex = ex_tree_[*it];
         if (prev_ex->Tried(depth)) continue;
-        vector<branch_id_t> context = prev_ex->GetContext(depth, k, dominator_);
-        if (context_cache_.count(context) > 0) continue;
+        hash_t context = context_index_.ContextHash(*prev_ex, depth, k);
+        if (context_cache_.Contains(context)) continue;
 
         prev_ex->SetTried(depth);
-        context_cache_.insert(context);
+        context_cache_.Insert(context);
         if (!SolveAtBranchNew(*prev_ex, depth, &input)) {
           continue;
         }
@@ -2055,17 +2385,25 @@ ParameterizedSearch::ParameterizedSearch(const string& prog_name,
 		int max_iterations, int max_time,
 		const string& weight_file)
 	: Search(prog_name, input_file, log_file, max_iterations, max_time),
-		cfg_(max_branch_) {
+		context_index_(5),
+		num_feature_evals_(0), num_feature_evals_skipped_(0),
+		feature_secs_(0.0), large_path_feature_secs_(0.0), num_large_paths_(0) {
 
 		const string& dom_file = "dominator";
 		const string& static_feature_file = "features";
 		const string& w_file = weight_file;
 		
 		// Read CFG & dominator
-		CfgHeuristicSearch::ReadCFG(branches_, cfg_);
+		{
+			vector<vector<branch_id_t> > cfg(max_branch_);
+			CfgHeuristicSearch::ReadCFG(branches_, cfg);
+			reach_index_.SetCfg(cfg, paired_branch_, branches_);
+		}
 		ContextGuidedSearch::ReadDominator(dom_file, dominator_);
+		context_index_.SetDominators(dominator_);
 
 		// Read static feature map
+		map<branch_id_t, vector<int> > static_feature_map;
 		ifstream fin(static_feature_file.c_str());
 		assert(fin);
 		string line;
@@ -2082,7 +2420,7 @@ ParameterizedSearch::ParameterizedSearch(const string& prog_name,
 				fv.push_back(pred);
 			} fv.pop_back();
 
-			static_feature_map_.insert(make_pair(bid, fv));
+			static_feature_map.insert(make_pair(bid, fv));
 		}
 
 		// Read weight
@@ -2092,36 +2430,55 @@ ParameterizedSearch::ParameterizedSearch(const string& prog_name,
 		while (win >> weight) {
 			weights_.push_back(weight);
 		}
+
+		// The static part of every score is fixed, so sum it up front.
+		static_scores_.resize(max_branch_ + 1, 0.0);
+		for (auto it = static_feature_map.begin(); it != static_feature_map.end(); ++it) {
+			if (it->first >= 0 && static_cast<size_t>(it->first) < static_scores_.size())
+				static_scores_[it->first] = inner_product(it->second.begin(),
+						it->second.end(), weights_.begin(), 0.0);
+		}
 	
  		dy_features_.push_back(new IsFrontBranch());
 		dy_features_.push_back(new IsEndBranch());
 		dy_features_.push_back(new IsMostFrequentlyAppearedInPath());
 		dy_features_.push_back(new IsLeastFrequentlyAppearedInPath());
-		dy_features_.push_back(new IsFreshBranch(newly_covered_branches_));
+		dy_features_.push_back(new IsFreshBranch(newly_covered_));
 		dy_features_.push_back(new IsFreshPartOfPath());
-		dy_features_.push_back(new IsVisitedContext(1, dominator_));
-		dy_features_.push_back(new IsVisitedContext(2, dominator_));
-		dy_features_.push_back(new IsVisitedContext(3, dominator_));
-		dy_features_.push_back(new IsVisitedContext(4, dominator_));
-		dy_features_.push_back(new IsVisitedContext(5, dominator_));
+		dy_features_.push_back(new IsVisitedContext(1, context_index_));
+		dy_features_.push_back(new IsVisitedContext(2, context_index_));
+		dy_features_.push_back(new IsVisitedContext(3, context_index_));
+		dy_features_.push_back(new IsVisitedContext(4, context_index_));
+		dy_features_.push_back(new IsVisitedContext(5, context_index_));
 		dy_features_.push_back(new IsFrequentlySelectedPair(10));
 		dy_features_.push_back(new IsFrequentlySelectedPair(20));
 		dy_features_.push_back(new IsFrequentlySelectedPair(30));
 		dy_features_.push_back(new IsNearNegatedBefore());
 		dy_features_.push_back(new IsFrequentlyUnsatBranch(bid_unsat_count_, paired_branch_, false));
 		dy_features_.push_back(new IsFrequentlyUnsatBranch(bid_unsat_count_, paired_branch_, true));
-		dy_features_.push_back(new IsPairedBranchUncovered(cfg_, total_covered_, paired_branch_, branches_, 0));
-		dy_features_.push_back(new IsPairedBranchUncovered(cfg_, total_covered_, paired_branch_, branches_, 1));
+		dy_features_.push_back(new IsPairedBranchUncovered(reach_index_, total_covered_, 0));
+		dy_features_.push_back(new IsPairedBranchUncovered(reach_index_, total_covered_, 1));
 		dy_features_.push_back(new IsRecentlySelectedBranch(10));
 		dy_features_.push_back(new IsRecentlySelectedBranch(20));
 		dy_features_.push_back(new IsRecentlySelectedBranch(30));
-		dy_features_.push_back(new IsInMostUncoveredFunc(total_covered_, branch_function_, fid_branches_map_));
-		dy_features_.push_back(new IsNearUncovered_Function(cfg_, total_covered_, paired_branch_, branches_, 2, fid_branches_map_, uncovered_function_id_, top10_threshold_));
-		dy_features_.push_back(new IsNearUncovered_Function(cfg_, total_covered_, paired_branch_, branches_, 2, fid_branches_map_, uncovered_function_id_, top20_threshold_));
-		dy_features_.push_back(new IsNearUncovered_Function(cfg_, total_covered_, paired_branch_, branches_, 2, fid_branches_map_, uncovered_function_id_, top30_threshold_));
-		dy_features_.push_back(new IsNearUncovered_Function(cfg_, total_covered_, paired_branch_, branches_, 2, fid_branches_map_, uncovered_function_id_, 10));
-		dy_features_.push_back(new IsInLatestCoveredFunc(branch_function_, fid_branches_map_, latest_covered_fid_));
-		assert(weights_.size() == dy_features_.size() + 12);
+		dy_features_.push_back(new IsInMostUncoveredFunc(total_covered_));
+		dy_features_.push_back(new IsNearUncovered_Function(reach_index_, paired_branch_, 2, fid_branch_begin_, fid_branches_, uncovered_function_id_, top10_threshold_));
+		dy_features_.push_back(new IsNearUncovered_Function(reach_index_, paired_branch_, 2, fid_branch_begin_, fid_branches_, uncovered_function_id_, top20_threshold_));
+		dy_features_.push_back(new IsNearUncovered_Function(reach_index_, paired_branch_, 2, fid_branch_begin_, fid_branches_, uncovered_function_id_, top30_threshold_));
+		dy_features_.push_back(new IsNearUncovered_Function(reach_index_, paired_branch_, 2, fid_branch_begin_, fid_branches_, uncovered_function_id_, kNearFunctionMinBranches));
+		dy_features_.push_back(new IsInLatestCoveredFunc(fid_branch_begin_, latest_covered_fid_));
+		assert(weights_.size() == dy_features_.size() + kNumStaticFeatures);
+		assert(dy_features_.size() <= 64);
+
+		// Heaviest features first, so that the score bounds close quickly.
+		for (size_t f = 0; f < dy_features_.size(); ++f) {
+			if (weights_[kNumStaticFeatures + f] != 0.0)
+				feature_order_.push_back(f);
+		}
+		const double* dy_weights = &weights_[kNumStaticFeatures];
+		stable_sort(feature_order_.begin(), feature_order_.end(),
+				[dy_weights](size_t a, size_t b) {
+					return fabs(dy_weights[a]) > fabs(dy_weights[b]); });
 }
 		
 ParameterizedSearch::~ParameterizedSearch() {}
@@ -2147,31 +2504,47 @@ bool ParameterizedSearch::DoSearch(SymbolicExecution& ex)
 	const auto& cidxs = ex.path().constraints_idx();
 	const auto& branches = ex.path().branches();
 
-	const auto& fv_map = ExtractFeatures(ex);
-	auto candidates = ComputeScores(fv_map);
+	ExtractFeatures(ex);
+	CandidateQueue candidates;
+	ComputeScores(&candidates);
 	
 	int trial = 0;
+	size_t first_cidx = 0;
 	while (!candidates.empty()) {
-		double score = candidates.back().first;
-		size_t cidx = candidates.back().second;
-		candidates.pop_back();
-		trial++;
+		if ((trial == 1) && !deferred_features_.empty()) {
+			// Only the best candidate was settled without the deferred
+			// features; the others need their exact scores.
+			CompleteFeatures(ex);
+			ComputeScores(&candidates);
+			assert(candidates.Peek(0).second == first_cidx);
+			candidates.Pop();
+			if (candidates.empty())
+				break;
+		}
+		double score = candidates.Peek(0).first;
+		size_t cidx = candidates.Peek(0).second;
+		candidates.Pop();
+		if (trial++ == 0)
+			first_cidx = cidx;
 
 		branch_id_t bid = branches[cidxs[cidx]];
 
-		if (bid_unsat_counter_[bid] > 70)
+		if (IsTooCostly(bid))
 			continue;
+
+		if (solver_pool_ && !solver_pool_->Pending(ex, cidx))
+			StartSpeculativeSolves(ex, cidx, &candidates);
                
 		vector<value_t> new_input;
-		if(!SolveAtBranch(ex, cidx, &new_input)) {
-			bid_unsat_counter_[bid]++;
+		if(!SolveAtBranch(ex, cidx, &new_input))
 			continue;
-		}
 
 		if(inputs_tried_.count(new_input) > 0) {
 			continue;
 		}
 		inputs_tried_.insert(new_input);
+		if (solver_pool_)
+			solver_pool_->Cancel();
 		
 		fprintf(stderr, "CIDX: %lu, BID: %d, SCORE: %lf TRIAL: %d\n", cidx, bid, score, trial);
 
@@ -2179,63 +2552,253 @@ bool ParameterizedSearch::DoSearch(SymbolicExecution& ex)
 		RunProgram(new_input, &cur_ex);
 		UpdateCoverage(cur_ex);
 		bool prediction_failure = CheckPrediction(ex, cur_ex, cidxs[cidx]);
+		if (!prediction_failure && num_models_ > 1) {
+			// (CheckPrediction is true when the branch did flip.)  The model
+			// missed the branch, so retry it with other models of the query.
+			// The prediction was recorded above, once for the branch; the
+			// retries only count as retries, and stop at the iteration
+			// budget rather than ending the search from inside this loop.
+			vector<vector<value_t> > retries;
+			DiverseInputs(ex, cidx, new_input, &retries);
+			for (auto it = retries.begin();
+					it != retries.end() && !prediction_failure
+					&& BudgetLeft(); ++it) {
+				if (inputs_tried_.count(*it) > 0)
+					continue;
+				inputs_tried_.insert(*it);
+				num_model_retries_++;
+				SymbolicExecution retry_ex;
+				RunProgram(*it, &retry_ex);
+				UpdateCoverage(retry_ex);
+				prediction_failure = BranchFlipped(ex, retry_ex, cidxs[cidx]);
+				if (prediction_failure)
+					num_model_retry_hits_++;
+				cur_ex.Swap(retry_ex);
+			}
+		}
 		UpdateFeatureState(GenExecStatus(&ex, cidx, bid, prediction_failure));
 	    new_ex_.Swap(cur_ex);	
 		return true;
 	}
+	if (solver_pool_)
+		solver_pool_->Cancel();
+	// The features keep their values for this path until the next update.
+	CompleteFeatures(ex);
 	return false;
 }
 
+void ParameterizedSearch::StartSpeculativeSolves(const SymbolicExecution& ex,
+		size_t cidx, CandidateQueue* candidates)
+{
+	// Solve 'cidx' together with the next best candidates that DoSearch
+	// would try after it, skipping the ones it is known to skip.
+	const auto& cidxs = ex.path().constraints_idx();
+	const auto& branches = ex.path().branches();
+	vector<size_t> idxs(1, cidx);
+	for (size_t i = 0;
+			i < candidates->size() && idxs.size() < solver_pool_->num_workers(); ++i) {
+		size_t next = candidates->Peek(i).second;
+		branch_id_t bid = branches[cidxs[next]];
+		if (IsTooCostly(bid) || IsRepeatedConstraint(ex, next))
+			continue;
+		idxs.push_back(next);
+	}
+	solver_pool_->Start(ex, idxs);
+}
+
 void ParameterizedSearch::UpdateFeatureState(const ExecStatus& ex_stat)
 {
-	for (auto it = dy_features_.begin(); it != dy_features_.end(); ++it) {
-		(*it)->UpdateFeatureState(ex_stat);
+	for (auto it = feature_order_.begin(); it != feature_order_.end(); ++it) {
+		dy_features_[*it]->UpdateFeatureState(ex_stat);
 	}
 }
-map< size_t, vector<int> >
-ParameterizedSearch::ExtractFeatures(const SymbolicExecution& ex)
+void ParameterizedSearch::ExtractFeatures(const SymbolicExecution& ex)
 {
-	map< size_t, vector<int> > fvmap;
 	const auto& cidxs = ex.path().constraints_idx();
 	const auto& branches = ex.path().branches();
 
-	for (auto fit = dy_features_.begin(); fit != dy_features_.end(); ++fit) {
-		if ((*fit)->IsReadyToCompute())
-			(*fit)->ComputeFeature(ex);
+	path_summary_.Build(ex, branch_function_);
+
+	/* Static features */
+	row_static_scores_.resize(cidxs.size());
+	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx)
+		row_static_scores_[cidx] = static_scores_[branches[cidxs[cidx]]];
+
+	/* Dynamic features */
+	row_dynamic_bits_.assign(cidxs.size(), 0);
+	if ((feature_min_rows_ > 0) && (cidxs.size() >= feature_min_rows_))
+		num_large_paths_++;
+	partial_scores_.assign(row_static_scores_.begin(), row_static_scores_.end());
+	deferred_features_.clear();
+	// (Features weighted zero are never updated, so never ready; count
+	// them as skipped.)
+	const size_t num_zero_weight = dy_features_.size() - feature_order_.size();
+	num_feature_evals_ += num_zero_weight;
+	num_feature_evals_skipped_ += num_zero_weight;
+	double remaining = 0.0;
+	for (auto it = feature_order_.begin(); it != feature_order_.end(); ++it) {
+		if (dy_features_[*it]->IsReadyToCompute()) {
+			num_feature_evals_++;
+			remaining += fabs(weights_[kNumStaticFeatures + *it]);
+		}
 	}
 
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
-		branch_id_t bid = branches[cidxs[cidx]];
-		/* Static features */
-		vector<int> fvector = static_feature_map_.find(bid)->second;
+	// Once no remaining feature can change which candidate is best, leave
+	// them for CompleteFeatures -- DoSearch only needs them if that
+	// candidate is rejected.  The speculative solves need the whole order.
+	bool settled = false;
+	for (auto it = feature_order_.begin(); it != feature_order_.end(); ++it) {
+		if (!dy_features_[*it]->IsReadyToCompute())
+			continue;
+		if (!settled && !solver_pool_)
+			settled = IsBestSettled(remaining);
+		if (settled) {
+			deferred_features_.push_back(*it);
+			num_feature_evals_skipped_++;
+			continue;
+		}
+		EvaluateFeature(ex, *it);
+		remaining -= fabs(weights_[kNumStaticFeatures + *it]);
+	}
+}
 
-		/* Dynamic features */
-		for (auto fit = dy_features_.begin(); fit != dy_features_.end(); ++fit)
-			fvector.push_back((*fit)->Predicate(cidx));
+void ParameterizedSearch::EvaluateFeature(const SymbolicExecution& ex, size_t f)
+{
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	DynamicFeature* feature = dy_features_[f];
+	feature->ComputeFeature(ex, path_summary_);
+	if (check_features_ && feature->IsPrefixStable()
+			&& !feature->CheckIncremental(ex, path_summary_)) {
+		fprintf(stderr, "Incremental feature %zu differs from its recomputation "
+				"(iteration %d).\n", f, num_iters_);
+		exit(1);
+	}
 
-		fvmap.insert(pair< size_t, vector<int> >(cidx, fvector));
+	const double w = weights_[kNumStaticFeatures + f];
+	const uint64_t bit = static_cast<uint64_t>(1) << f;
+	for (size_t cidx = 0; cidx < row_dynamic_bits_.size(); ++cidx) {
+		if (feature->Predicate(cidx)) {
+			row_dynamic_bits_[cidx] |= bit;
+			partial_scores_[cidx] += w;
+		}
 	}
 
-	return fvmap;
+	gettimeofday(&end, NULL);
+	double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+	feature_secs_ += secs;
+	if ((feature_min_rows_ > 0) && (row_dynamic_bits_.size() >= feature_min_rows_))
+		large_path_feature_secs_ += secs;
 }
 
+// True if the best row by partial score stays best whatever the features
+// of total weight 'remaining' add, allowing for the rounding of the full
+// scores, which ScoreRows sums in another order.
+bool ParameterizedSearch::IsBestSettled(double remaining) const
+{
+	const size_t n = partial_scores_.size();
+	if (n == 0)
+		return true;
+	// The queue breaks ties towards the larger cidx.
+	size_t best = 0;
+	for (size_t cidx = 1; cidx < n; ++cidx) {
+		if (partial_scores_[cidx] >= partial_scores_[best])
+			best = cidx;
+	}
+	double second = -numeric_limits<double>::infinity();
+	for (size_t cidx = 0; cidx < n; ++cidx) {
+		if (cidx != best)
+			second = max(second, partial_scores_[cidx]);
+	}
+	double margin = 1e-9 * (1.0 + fabs(partial_scores_[best]) + remaining);
+	return partial_scores_[best] - second > remaining + margin;
+}
 
-vector< pair<double, size_t> >
-ParameterizedSearch::ComputeScores(const map< size_t, vector<int> >& fvmap)
+void ParameterizedSearch::CompleteFeatures(const SymbolicExecution& ex)
 {
-	vector< pair<double, size_t> > scored_idxs;
-	
-	for (auto it = fvmap.begin(); it != fvmap.end(); ++it) {
-		size_t cidx = it->first;
-		vector<int> fv = it->second;
-	        
+	for (auto it = deferred_features_.begin(); it != deferred_features_.end(); ++it)
+		EvaluateFeature(ex, *it);
+	if (!deferred_features_.empty())
+		num_feature_evals_skipped_ -= deferred_features_.size();
+	deferred_features_.clear();
+}
 
-		double score = inner_product(fv.begin(), fv.end(), weights_.begin(), 0.0);
-		scored_idxs.push_back(pair<double, size_t>(score, cidx));
+void ParameterizedSearch::PrintStrategyStats(FILE* f)
+{
+	fprintf(f, "Feature evaluations: %lu skipped of %lu (%.1lf%%), "
+			"%zu of %zu features weighted zero\n",
+			num_feature_evals_skipped_, num_feature_evals_,
+			num_feature_evals_ > 0 ? 100.0 * num_feature_evals_skipped_ / num_feature_evals_ : 0.0,
+			dy_features_.size() - feature_order_.size(), dy_features_.size());
+	fprintf(f, "Feature time: %.3lfs", feature_secs_);
+	if (feature_min_rows_ > 0) {
+		fprintf(f, ", %.3lfs on %lu paths of %zu+ constraints",
+				large_path_feature_secs_, num_large_paths_, feature_min_rows_);
 	}
-	std::sort(scored_idxs.begin(), scored_idxs.end());
-	
-		return scored_idxs;
+	fprintf(f, "\n");
+	if (row_pool_) {
+		const RowPool& p = *row_pool_;
+		fprintf(f, "Feature loops: %lu rows serially in %.3lfs, %lu rows in %lu loops "
+				"on %zu threads in %.3lfs\n",
+				p.num_serial_rows(), p.serial_secs(), p.num_parallel_rows(),
+				p.num_parallel_runs(), p.num_threads(), p.parallel_secs());
+	}
+}
+
+
+void ParameterizedSearch::ComputeScores(CandidateQueue* candidates)
+{
+	const size_t n = row_static_scores_.size();
+	vector<double> scores(n);
+	if (n > 0) {
+		ScoreRows(&row_static_scores_.front(), &row_dynamic_bits_.front(), n,
+				&weights_[kNumStaticFeatures], dy_features_.size(), &scores.front());
+	}
+
+	vector< pair<double, size_t> > scored_idxs(n);
+	for (size_t cidx = 0; cidx < n; ++cidx)
+		scored_idxs[cidx] = pair<double, size_t>(scores[cidx], cidx);
+	candidates->Reset(&scored_idxs);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+//// CandidateQueue ////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+void CandidateQueue::Reset(vector<pair<double, size_t> >* scored) {
+  scored_.swap(*scored);
+  scored->clear();
+  num_unsorted_ = scored_.size();
+  block_ = kFirstBlock;
+}
+
+const pair<double, size_t>& CandidateQueue::Peek(size_t i) {
+  assert(i < scored_.size());
+  SortBest(i + 1);
+  return scored_[scored_.size() - 1 - i];
+}
+
+void CandidateQueue::Pop() {
+  assert(!scored_.empty());
+  SortBest(1);
+  scored_.pop_back();
+}
+
+void CandidateQueue::SortBest(size_t n) {
+  while (scored_.size() - num_unsorted_ < n) {
+    auto begin = scored_.begin();
+    if (num_unsorted_ <= block_) {
+      std::sort(begin, begin + num_unsorted_);
+      num_unsorted_ = 0;
+    } else {
+      auto mid = begin + (num_unsorted_ - block_);
+      std::nth_element(begin, mid, begin + num_unsorted_);
+      std::sort(mid, begin + num_unsorted_);
+      num_unsorted_ -= block_;
+      block_ *= 2;
+    }
+  }
 }
 
 
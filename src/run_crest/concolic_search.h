@@ -15,6 +15,8 @@
 #include <vector>
 //#include <ext/hash_map>
 //#include <ext/hash_set>
+#include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
 /*
@@ -26,6 +28,8 @@
 #include "base/basic_types.h"
 #include "base/symbolic_execution.h"
 #include "run_crest/feature.h"
+#include "run_crest/rank_index.h"
+#include "run_crest/solver_pool.h"
 
 using std::map;
 using std::vector;
@@ -47,32 +51,72 @@ class Search {
 
   virtual void Run() = 0;
 
+  // Solve branch negations in 'num_workers' worker processes.  Only
+  // searches that call SolverPool::Start benefit.
+  void EnableSolverPool(size_t num_workers);
+
+  // Skip (or, in the CFG search, deprioritize) branches whose expected
+  // solver time per satisfiable answer exceeds 'secs'.  Without a limit,
+  // branches are only skipped after 70 failed solves.
+  void SetMaxBranchCost(double secs);
+
+  // Extract up to 'n' models from each satisfiable query that needs
+  // them.  -param retries a branch with the extra models when the first
+  // one fails to flip it.
+  void SetNumModels(size_t n);
+
+  // Solve only the last 'n' or more constraints of each dependent slice
+  // (see YicesSolver::SetWindow).  The window doubles whenever the input
+  // from a windowed query misses its branch, and halves again, down to
+  // 'n', after a run of hits.  0 solves whole slices.
+  void SetSolverWindow(size_t n);
+
+  // Check, after every incremental feature computation of -param, that
+  // the values equal a recomputation from scratch, and abort if not.
+  void CheckIncrementalFeatures(bool check);
+
+  // Split the feature loops of -param over 'num_threads' threads on paths
+  // (or sets of distinct branches) of at least 'min_rows' entries.  The
+  // features are the same as with one thread.
+  void SetFeatureThreads(size_t num_threads, size_t min_rows);
+
  protected:
   vector<branch_id_t> branches_;
   vector<branch_id_t> paired_branch_;
   vector<function_id_t> branch_function_;
-	map<function_id_t, set<branch_id_t> > fid_branches_map_;
-	set<function_id_t> latest_covered_fid_;
+	// The branches listed for function f in the "branches" file, sorted,
+	// are fid_branches_[fid_branch_begin_[f], fid_branch_begin_[f+1]).
+	// Every id in branch_function_ has a (possibly empty) row.
+	vector<size_t> fid_branch_begin_;
+	vector<branch_id_t> fid_branches_;
+	// The functions that have branches, in increasing order.
+	vector<function_id_t> branch_functions_;
+	vector<function_id_t> latest_covered_fid_;
   vector<bool> covered_;
   vector<bool> total_covered_;
-	set<branch_id_t> newly_covered_branches_;
- 	set<function_id_t> uncovered_function_id_;
+	// The branches first covered by the last run, listed and marked.
+	vector<branch_id_t> newly_covered_branches_;
+	vector<bool> newly_covered_;
+	// The unreached functions with branches, in no particular order, the
+	// position of each in that list (indexed by function id), and their
+	// numbers of branches.  UpdateCoverage drops the functions it reaches.
+ 	vector<function_id_t> uncovered_function_id_;
+	vector<size_t> uncovered_pos_;
+	RankIndex uncovered_sizes_;
 	int threshold_;
+	// The smallest number of branches among the largest 10/20/30% of the
+	// unreached functions, kept by UpdateFunctionThresholds.  The
+	// IsNearUncovered_Function features hold references to them.
 	int top10_threshold_;
 	int top20_threshold_;
 	int top30_threshold_;
+	bool thresholds_stale_;
 	double total;
   branch_id_t max_branch_;
   unsigned int num_covered_;
   unsigned int total_num_covered_;
   vector<pair<int, function_id_t> > fid_bidsize_;  
-  vector<pair<int, function_id_t> > unc_fid_bidsize_;  
   unsigned int init_coverage_;
-  map<branch_id_t, size_t> bid_history;  
-  map<int, size_t> b_unsat_count;
-  //CGS
-  map<int, size_t> selected_ex_no;
-  size_t ex_idx;
   vector<bool> reached_;
   vector<unsigned int> branch_count_;
   function_id_t max_function_;
@@ -81,8 +125,58 @@ class Search {
 
   unsigned int num_smt_unsat_;
   unsigned int num_smt_try_;
+  unsigned int num_prediction_checks_;
+  unsigned int num_prediction_failures_;
+  unsigned int num_execs_;  // programs run by RunProgram
+  unsigned int num_repeated_constraints_;
   vector<int> bid_unsat_count_;
 
+  // Solver effort spent negating each branch, indexed by the branch id
+  // recorded on the path: queries, failures (UNSAT, repeated, or timed
+  // out), timeouts, and seconds.
+  struct BranchSolveStats {
+    BranchSolveStats()
+      : num_solves(0), num_failures(0), num_timeouts(0), secs(0.0) { }
+    unsigned num_solves;
+    unsigned num_failures;
+    unsigned num_timeouts;
+    double secs;
+  };
+  vector<BranchSolveStats> branch_solve_stats_;
+  double max_branch_cost_;
+
+  // Models per query, and how the extra ones were used: extracted, run,
+  // and run with the branch flipped.
+  size_t num_models_;
+  unsigned num_extra_models_;
+  unsigned num_model_retries_;
+  unsigned num_model_retry_hits_;
+
+  // Adaptive solver window (see SetSolverWindow): its floor, current and
+  // largest size, the windowed query awaiting its prediction check (the
+  // input solved for and its branch index), and the outcomes of those
+  // checks.
+  size_t min_window_;
+  size_t window_;
+  size_t max_window_;
+  bool window_check_pending_;
+  vector<value_t> windowed_input_;
+  size_t windowed_branch_idx_;
+  unsigned num_window_hits_;  // in a row
+  unsigned num_window_checks_;
+  unsigned num_window_failures_;
+
+  bool check_features_;
+
+  // Threads for the feature loops (or NULL), and the path length from
+  // which they are used.
+  RowPool* row_pool_;
+  size_t feature_min_rows_;
+
+  // Speculative solver workers, or NULL.  SolveAtBranch collects a
+  // pending answer from the pool instead of solving itself.
+  SolverPool* solver_pool_;
+
   int num_iters_;
   time_t start_time_;
 
@@ -92,6 +186,31 @@ class Search {
 		     size_t branch_idx,
 		     vector<value_t>* input);
 
+  // True if an earlier path constraint equals the branch_idx-th one, in
+  // which case its negation is trivially unsatisfiable.  A lookup in the
+  // execution's first-occurrence index.
+  bool IsRepeatedConstraint(const SymbolicExecution& ex, size_t branch_idx);
+
+  // Expected solver seconds per satisfiable answer when negating 'bid':
+  // the mean time per query over the (smoothed) fraction of satisfiable
+  // answers.
+  double ExpectedSolveCost(branch_id_t bid) const;
+
+  // True if negating 'bid' is not worth another query (see
+  // SetMaxBranchCost).
+  bool IsTooCostly(branch_id_t bid) const;
+
+  // Stores up to num_models_ - 1 further inputs that flip the
+  // branch_idx-th branch of 'ex', each differing from 'input' (the one
+  // SolveAtBranch found) in the branch's slice.
+  void DiverseInputs(const SymbolicExecution& ex, size_t branch_idx,
+                     const vector<value_t>& input,
+                     vector< vector<value_t> >* inputs);
+
+  // Resizes the solver window after the prediction check of a windowed
+  // query.
+  void UpdateWindow(bool prediction_ok);
+
   bool SolveAtBranchOnly(const SymbolicExecution& ex,
 		     size_t branch_idx,
 		     vector<value_t>* input);
@@ -100,6 +219,13 @@ class Search {
 		     size_t branch_idx,
 		     vector<value_t>* input);
 
+  // True if 'new_ex' follows 'old_ex' up to its branch_idx-th branch and
+  // then takes the paired branch.  CheckPrediction also records the
+  // outcome in the prediction (and window) statistics.
+  bool BranchFlipped(const SymbolicExecution& old_ex,
+                     const SymbolicExecution& new_ex,
+                     size_t branch_idx) const;
+
   bool CheckPrediction(const SymbolicExecution& old_ex,
 		       const SymbolicExecution& new_ex,
 		       size_t branch_idx);
@@ -110,6 +236,7 @@ class Search {
   bool UpdateCoverage(const SymbolicExecution& ex);
   bool UpdateCoverage(const SymbolicExecution& ex,
 		      set<branch_id_t>* new_branches);
+  void UpdateFunctionThresholds();
 
   void CheckTarget(const int tbid);
   void RandomInput(const map<var_t,type_t>& vars, vector<value_t>* input);
@@ -117,10 +244,17 @@ class Search {
 
   void InitialInput(vector<value_t>& inputs);
   void PrintFinalResult();
+  void PrintSolverStats(FILE* f);
+  void PrintPredictionStats(FILE* f);
+  virtual void PrintStrategyStats(FILE* f) { }
 
   void SaveInput(const vector<value_t>& input, const char* str);
   int GetNumIters();
 
+  // True if the next RunProgram is within the iteration and time budget,
+  // i.e. will not end the search.
+  bool BudgetLeft() const;
+
  private:
   const string program_;
   const string input_file_; // initial input file
@@ -335,7 +469,6 @@ class CGSSymbolicExecution: public SymbolicExecution {
     void InitTried();
     void SetTried(int cidx);
     bool Tried(int cidx);
-    vector<branch_id_t> GetContext(int cidx, size_t k, map< branch_id_t, set<branch_id_t> > &dominator);
   private:
     vector<bool> tried_;
 };
@@ -359,7 +492,8 @@ class ContextGuidedSearch : public Search {
  private:
   size_t max_k_;
   vector<CGSSymbolicExecution*> ex_tree_;
-  set< vector<branch_id_t> > context_cache_;
+  ContextIndex context_index_;
+  ContextSet context_cache_;
   map< branch_id_t, set<branch_id_t> > dominator_;
   
   int GetMaxDepthT(); // Return the maximum depth of T.
@@ -401,6 +535,40 @@ class TestingSearch : public Search {
 	const string out_file_;
 };
 		
+// Scored branch candidates, handed out best first: by score, ties going
+// to the later constraint (the reverse of sorted (score, cidx) order).
+// Only a block of the best remaining candidates is kept sorted; it is
+// selected (nth_element) and sorted when needed, and each new block is
+// twice the size of the last.  Taking the first few of n candidates then
+// costs O(n) instead of a full O(n log n) sort.
+class CandidateQueue {
+ public:
+  CandidateQueue() : num_unsorted_(0), block_(kFirstBlock) { }
+
+  // Replaces the candidates with those in 'scored' (which is cleared).
+  void Reset(vector<pair<double, size_t> >* scored);
+
+  bool empty() const { return scored_.empty(); }
+  size_t size() const { return scored_.size(); }
+
+  // The i-th best remaining candidate (0 is the best).
+  const pair<double, size_t>& Peek(size_t i);
+
+  void Pop();
+
+ private:
+  static const size_t kFirstBlock = 16;
+
+  // Ensures the best 'n' remaining candidates are sorted.
+  void SortBest(size_t n);
+
+  // scored_[0, num_unsorted_) is unsorted and precedes (in sorted order)
+  // the rest, which is sorted; the best candidate is last.
+  vector<pair<double, size_t> > scored_;
+  size_t num_unsorted_;
+  size_t block_;
+};
+
 class ParameterizedSearch : public Search {
  public:
 	explicit ParameterizedSearch(const string& program,
@@ -414,18 +582,48 @@ class ParameterizedSearch : public Search {
   	SymbolicExecution new_ex_;
 	vector<double> weights_;
 	vector<DynamicFeature*> dy_features_;
-	vector<vector<branch_id_t> > cfg_;
+	PathSummary path_summary_;
+	ReachIndex reach_index_;  // for the proximity features
 	map<branch_id_t, set<branch_id_t> > dominator_;
-	map<branch_id_t, vector<int> > static_feature_map_;
+	ContextIndex context_index_;  // for IsVisitedContext
 	set<vector<value_t> > inputs_tried_;
-	map<branch_id_t, int> bid_unsat_counter_;
 
-	typedef map<size_t, vector<int> > fv_map_t;
+	// The weighted sum of each branch's static features, indexed by
+	// branch id.
+	vector<double> static_scores_;
+
+	// The feature matrix of the current path, one row per constraint: the
+	// static score of its branch, and its dynamic features as one bit per
+	// feature.
+	vector<double> row_static_scores_;
+	vector<uint64_t> row_dynamic_bits_;
+
+	// The dynamic features with nonzero weights, by decreasing |weight|
+	// (features weighted zero are never computed), and the ones the last
+	// ExtractFeatures left for CompleteFeatures.  partial_scores_ are the
+	// rows' scores over the features computed so far.
+	vector<size_t> feature_order_;
+	vector<size_t> deferred_features_;
+	vector<double> partial_scores_;
+	unsigned long num_feature_evals_;
+	unsigned long num_feature_evals_skipped_;
+
+	// Time spent computing features, and on paths of at least
+	// feature_min_rows_ constraints, and the number of such paths.
+	double feature_secs_;
+	double large_path_feature_secs_;
+	unsigned long num_large_paths_;
 
 	bool DoSearch(SymbolicExecution& ex);
+	void StartSpeculativeSolves(const SymbolicExecution& ex, size_t cidx,
+			CandidateQueue* candidates);
 	void UpdateFeatureState(const ExecStatus& ex_stat);
-	fv_map_t ExtractFeatures(const SymbolicExecution& ex);
-	vector<pair<double, size_t> > ComputeScores(const fv_map_t& fv_map);
+	void ExtractFeatures(const SymbolicExecution& ex);
+	void EvaluateFeature(const SymbolicExecution& ex, size_t f);
+	bool IsBestSettled(double remaining) const;
+	void CompleteFeatures(const SymbolicExecution& ex);
+	void ComputeScores(CandidateQueue* candidates);
+	virtual void PrintStrategyStats(FILE* f);
 };
 
 
@@ -0,0 +1,159 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <assert.h>
+
+#include "run_crest/context_index.h"
+
+namespace crest {
+
+namespace {
+
+const hash_t kFnvOffsetBasis = 14695981039346656037ULL;
+const hash_t kFnvPrime = 1099511628211ULL;
+
+hash_t FnvAppend(hash_t h, branch_id_t bid) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(&bid);
+  for (size_t i = 0; i < sizeof(bid); i++) {
+    h ^= p[i];
+    h *= kFnvPrime;
+  }
+  return h;
+}
+
+}  // namespace
+
+
+ContextIndex::ContextIndex(size_t max_k)
+  : max_k_(max_k), dom_begin_(1, 0), generation_(0) {
+  assert(max_k_ > 0);
+}
+
+void ContextIndex::SetDominators(
+    const map<branch_id_t, set<branch_id_t> >& dominator) {
+  branch_id_t max_bid = -1;
+  typedef map<branch_id_t, set<branch_id_t> >::const_iterator DomIt;
+  for (DomIt i = dominator.begin(); i != dominator.end(); ++i) {
+    max_bid = std::max(max_bid, i->first);
+  }
+
+  dom_begin_.assign(max_bid + 2, 0);
+  doms_.clear();
+  DomIt it = dominator.begin();
+  for (branch_id_t b = 0; b <= max_bid; b++) {
+    dom_begin_[b] = doms_.size();
+    while ((it != dominator.end()) && (it->first < b))
+      ++it;
+    if ((it != dominator.end()) && (it->first == b))
+      doms_.insert(doms_.end(), it->second.begin(), it->second.end());
+  }
+  dom_begin_[max_bid + 1] = doms_.size();
+  generation_ = 0;
+}
+
+bool ContextIndex::IsDominatedBy(branch_id_t bid, branch_id_t dom) const {
+  if ((bid < 0) || (static_cast<size_t>(bid) + 1 >= dom_begin_.size()))
+    return false;
+  return std::binary_search(doms_.begin() + dom_begin_[bid],
+                            doms_.begin() + dom_begin_[bid + 1], dom);
+}
+
+void ContextIndex::Walk(const SymbolicExecution& ex, size_t cidx, size_t k,
+                        hash_t* out) const {
+  const vector<branch_id_t>& branches = ex.path().branches();
+  int bidx = ex.path().constraints_idx()[cidx];
+  branch_id_t bid = branches[bidx];
+
+  hash_t h = FnvAppend(kFnvOffsetBasis, bid);
+  size_t len = 1;
+  out[0] = h ? h : 1;
+  for (bidx--; (bidx >= 0) && (len < k); bidx--) {
+    if (!IsDominatedBy(bid, branches[bidx])) {
+      h = FnvAppend(h, branches[bidx]);
+      out[len++] = h ? h : 1;
+    }
+  }
+  // Near the start of the path, the longer contexts are the same.
+  for (; len < k; len++) {
+    out[len] = out[len - 1];
+  }
+}
+
+size_t ContextIndex::Reset(size_t n, unsigned long generation,
+                           size_t num_shared) {
+  size_t old_n = hashes_.size() / max_k_;
+  if ((generation == generation_) && (n == old_n))
+    return n;
+  size_t first = (generation == generation_ + 1) ? std::min(num_shared, old_n) : 0;
+  generation_ = generation;
+  hashes_.resize(n * max_k_);
+  return first;
+}
+
+void ContextIndex::HashRows(const SymbolicExecution& ex, size_t begin, size_t end) {
+  for (size_t cidx = begin; cidx < end; cidx++) {
+    Walk(ex, cidx, max_k_, &hashes_[cidx * max_k_]);
+  }
+}
+
+hash_t ContextIndex::ContextHash(const SymbolicExecution& ex, size_t cidx,
+                                 size_t k) const {
+  vector<hash_t> out(k);
+  Walk(ex, cidx, k, &out.front());
+  return out[k - 1];
+}
+
+
+ContextSet::ContextSet() : slots_(16, 0), size_(0) { }
+
+size_t ContextSet::Slot(hash_t h) const {
+  // FNV's low bits are weak; mix the high ones in.
+  h ^= h >> 31;
+  h *= 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 29;
+  return h & (slots_.size() - 1);
+}
+
+bool ContextSet::Contains(hash_t h) const {
+  for (size_t i = Slot(h); slots_[i] != 0; i = (i + 1) & (slots_.size() - 1)) {
+    if (slots_[i] == h)
+      return true;
+  }
+  return false;
+}
+
+bool ContextSet::Insert(hash_t h) {
+  assert(h != 0);
+  if (2 * (size_ + 1) > slots_.size()) {
+    vector<hash_t> old(2 * slots_.size(), 0);
+    old.swap(slots_);
+    size_ = 0;
+    for (size_t i = 0; i < old.size(); i++) {
+      if (old[i] != 0)
+        Insert(old[i]);
+    }
+  }
+  size_t i = Slot(h);
+  for (; slots_[i] != 0; i = (i + 1) & (slots_.size() - 1)) {
+    if (slots_[i] == h)
+      return false;
+  }
+  slots_[i] = h;
+  size_++;
+  return true;
+}
+
+void ContextSet::Clear() {
+  slots_.assign(16, 0);
+  size_ = 0;
+}
+
+}  // namespace crest
@@ -0,0 +1,103 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef RUN_CREST_CONTEXT_INDEX_H__
+#define RUN_CREST_CONTEXT_INDEX_H__
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_execution.h"
+
+using std::map;
+using std::set;
+using std::vector;
+
+namespace crest {
+
+// The k-context of a constraint (as used by CGS and -param) is its
+// branch followed by the nearest k-1 earlier branches of the path that
+// its branch is not dominated by.  The k-context is thus a prefix of the
+// (k+1)-context, and one backward walk from a constraint yields all of
+// them.  Contexts are represented by a rolling (FNV-1a) hash of their
+// branches, which is never 0.
+//
+// The index keeps the hashes of every k-context, k = 1..max_k, of each
+// constraint of the current path.
+class ContextIndex {
+ public:
+  explicit ContextIndex(size_t max_k);
+
+  void SetDominators(const map<branch_id_t, set<branch_id_t> >& dominator);
+
+  size_t max_k() const { return max_k_; }
+
+  // Makes room for a path of 'n' constraints, numbered 'generation' (see
+  // PathSummary), of which the first 'num_shared' are those of the path
+  // of generation-1.  Returns the first constraint whose contexts must be
+  // hashed (with HashRows): 0 for an unrelated path, 'n' if the path is
+  // already hashed.
+  size_t Reset(size_t n, unsigned long generation, size_t num_shared);
+
+  // Hashes the contexts of constraints [begin, end) of 'ex'.  Calls on
+  // disjoint ranges may run concurrently.
+  void HashRows(const SymbolicExecution& ex, size_t begin, size_t end);
+
+  // The k-context of constraint 'cidx' of the indexed path.
+  hash_t hash(size_t cidx, size_t k) const {
+    return hashes_[cidx * max_k_ + k - 1];
+  }
+
+  // The k-context of constraint 'cidx' of 'ex', by itself.
+  hash_t ContextHash(const SymbolicExecution& ex, size_t cidx, size_t k) const;
+
+ private:
+  bool IsDominatedBy(branch_id_t bid, branch_id_t dom) const;
+
+  // Writes the hashes of the 1..k-contexts of constraint 'cidx' of 'ex'.
+  void Walk(const SymbolicExecution& ex, size_t cidx, size_t k, hash_t* out) const;
+
+  const size_t max_k_;
+
+  // The dominators of branch b, sorted, are
+  // doms_[dom_begin_[b], dom_begin_[b+1]).
+  vector<size_t> dom_begin_;
+  vector<branch_id_t> doms_;
+
+  unsigned long generation_;
+  vector<hash_t> hashes_;
+};
+
+// A set of context hashes, in one open-addressed table.  Contains() may
+// be called concurrently (but not with Insert()).
+class ContextSet {
+ public:
+  ContextSet();
+
+  // Returns true if 'h' was not in the set.
+  bool Insert(hash_t h);
+  bool Contains(hash_t h) const;
+
+  size_t size() const { return size_; }
+  void Clear();
+
+ private:
+  // 0 marks an empty slot (no context hashes to 0).
+  vector<hash_t> slots_;
+  size_t size_;
+
+  size_t Slot(hash_t h) const;
+};
+
+}  // namespace crest
+
+#endif  // RUN_CREST_CONTEXT_INDEX_H__
@@ -4,6 +4,7 @@
 namespace crest {
 
 int DynamicFeature::feature_counter_ = 12;
+RowPool* DynamicFeature::row_pool_ = NULL;
 
 ExecStatus GenExecStatus(SymbolicExecution* ex,
 		size_t neg_cidx, branch_id_t neg_bid, bool prediction_failure)
@@ -17,6 +18,71 @@ ExecStatus GenExecStatus(SymbolicExecution* ex,
 	return ex_stat;
 }
 
+PathSummary::PathSummary()
+	: generation_(0), num_shared_(0), stamp_(0), max_prefix_count_(0) {}
+
+void PathSummary::Build(const SymbolicExecution& ex,
+		const vector<unsigned int>& branch_function)
+{
+	const auto& cidxs = ex.path().constraints_idx();
+	const auto& branches = ex.path().branches();
+	const size_t n = cidxs.size();
+
+	// Compare with the previous path: its branches up to the longest
+	// common prefix, then its constraints' positions within that.
+	generation_++;
+	size_t common = 0;
+	while ((common < branches.size()) && (common < prev_branches_.size())
+			&& (branches[common] == prev_branches_[common]))
+		common++;
+	num_shared_ = 0;
+	while ((num_shared_ < n) && (num_shared_ < prev_cidxs_.size())
+			&& (cidxs[num_shared_] == prev_cidxs_[num_shared_])
+			&& (cidxs[num_shared_] < common))
+		num_shared_++;
+	prev_cidxs_.assign(cidxs.begin(), cidxs.end());
+	prev_branches_.assign(branches.begin(), branches.end());
+
+	// A new stamp invalidates the previous path's slots.
+	if (++stamp_ == 0) {
+		slot_stamp_.assign(slot_stamp_.size(), 0);
+		stamp_ = 1;
+	}
+
+	bids_.resize(n);
+	fids_.resize(n);
+	slots_.resize(n);
+	distinct_bids_.clear();
+	for (size_t cidx = 0; cidx < n; ++cidx) {
+		branch_id_t bid = branches[cidxs[cidx]];
+		bids_[cidx] = bid;
+		fids_[cidx] = branch_function[bid];
+		if (static_cast<size_t>(bid) >= slot_of_.size()) {
+			slot_of_.resize(bid + 1);
+			slot_stamp_.resize(bid + 1, 0);
+		}
+		if (slot_stamp_[bid] != stamp_) {
+			slot_stamp_[bid] = stamp_;
+			slot_of_[bid] = distinct_bids_.size();
+			distinct_bids_.push_back(bid);
+		}
+		slots_[cidx] = slot_of_[bid];
+	}
+
+	for (size_t i = 0; i < counted_.size(); ++i)
+		prefix_count_[counted_[i]] = 0;
+	counted_.clear();
+	max_prefix_count_ = 0;
+	for (size_t i = 0; i < n; ++i) {
+		branch_id_t bid = branches[i];
+		if (static_cast<size_t>(bid) >= prefix_count_.size())
+			prefix_count_.resize(bid + 1, 0);
+		if (prefix_count_[bid]++ == 0)
+			counted_.push_back(bid);
+		max_prefix_count_ = std::max(max_prefix_count_, prefix_count_[bid]);
+	}
+}
+
 DynamicFeature::DynamicFeature()
 	: feature_idx_(feature_counter_), ready_(false) {
 		DynamicFeature::feature_counter_++;
@@ -34,6 +100,14 @@ void DynamicFeature::UpdateFeatureState(const ExecStatus& ex_stat)
 
 void DynamicFeature::UpdateFeatureStateImpl(const ExecStatus& ex) {}
 
+void DynamicFeature::ForEachRowRange(size_t n, const RowPool::RangeFn& fn)
+{
+	if (row_pool_)
+		row_pool_->Run(n, fn);
+	else
+		fn(0, n);
+}
+
 bool DynamicFeature::Predicate(size_t cidx)
 {
 	if (ready_) {
@@ -48,12 +122,12 @@ IsFrontBranch::IsFrontBranch()
 
 IsFrontBranch::~IsFrontBranch() {}
 
-void IsFrontBranch::ComputeFeature(const SymbolicExecution& ex)
+void IsFrontBranch::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-	size_t top_size = cidxs.size() * 0.1;
+	size_t top_size = path.size() * 0.1;
 	
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
 		if (cidx < top_size)
 			checked_cidxs_.push_back(true);
 		else
@@ -66,11 +140,11 @@ IsEndBranch::IsEndBranch()
 
 IsEndBranch::~IsEndBranch() {}
 
-void IsEndBranch::ComputeFeature(const SymbolicExecution& ex) {
-	const auto& cidxs = ex.path().constraints_idx();
-	size_t bottom_size = cidxs.size() * 0.9;
+void IsEndBranch::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path) {
+	size_t bottom_size = path.size() * 0.9;
 	
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
 		if (cidx > bottom_size)
 			checked_cidxs_.push_back(true);
 		else
@@ -83,24 +157,14 @@ IsMostFrequentlyAppearedInPath::IsMostFrequentlyAppearedInPath()
 
 IsMostFrequentlyAppearedInPath::~IsMostFrequentlyAppearedInPath() {}
 
-void IsMostFrequentlyAppearedInPath::ComputeFeature(const SymbolicExecution& ex)
+void IsMostFrequentlyAppearedInPath::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-	const auto& branches = ex.path().branches();
-
-	map<branch_id_t, size_t> branch_counter;
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
-		branch_id_t bid = branches[cidx];
-		branch_counter[bid]++;
-	}
-		
-	int max_count = std::max_element(branch_counter.begin(), branch_counter.end(),
-				[](const pair<branch_id_t, size_t>& p1, const pair<branch_id_t, size_t>& p2)
-				{ return p1.second < p2.second; })->second;
+	const auto& bids = path.bids();
+	size_t max_count = path.max_prefix_count();
 
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
-		branch_id_t bid = branches[cidxs[cidx]];
-		if (branch_counter[bid] == max_count)
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
+		if (path.prefix_count(bids[cidx]) == max_count)
 			checked_cidxs_.push_back(true);
 		else
 			checked_cidxs_.push_back(false);
@@ -112,24 +176,17 @@ IsLeastFrequentlyAppearedInPath::IsLeastFrequentlyAppearedInPath()
 
 IsLeastFrequentlyAppearedInPath::~IsLeastFrequentlyAppearedInPath() {}
 
-void IsLeastFrequentlyAppearedInPath::ComputeFeature(const SymbolicExecution& ex)
+void IsLeastFrequentlyAppearedInPath::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-	const auto& branches = ex.path().branches();
-
-	map<branch_id_t, size_t> branch_counter;
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
-		branch_id_t bid = branches[cidx];
-		branch_counter[bid]++;
-	}
-		
-	int min_count = std::min_element(branch_counter.begin(), branch_counter.end(),
-				[](const pair<branch_id_t, size_t>& p1, const pair<branch_id_t, size_t>& p2)
-				{ return p1.second > p2.second; })->second;
-
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
-		branch_id_t bid = branches[cidxs[cidx]];
-		if (branch_counter[bid] == min_count)
+	const auto& bids = path.bids();
+	// The learned weights were trained with this feature selecting the
+	// largest count (min_element under a reversed comparison), so it keeps
+	// doing so.
+	size_t min_count = path.max_prefix_count();
+
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
+		if (path.prefix_count(bids[cidx]) == min_count)
 			checked_cidxs_.push_back(true);
 		else
 			checked_cidxs_.push_back(false);
@@ -137,19 +194,16 @@ void IsLeastFrequentlyAppearedInPath::ComputeFeature(const SymbolicExecution& ex
 }
 
 
-IsFreshBranch::IsFreshBranch(const set<branch_id_t>& newly_covered)
+IsFreshBranch::IsFreshBranch(const vector<bool>& newly_covered)
 	: DynamicFeature(), newly_covered_(newly_covered) {}
 
 IsFreshBranch::~IsFreshBranch() {}
 
-void IsFreshBranch::ComputeFeature(const SymbolicExecution& ex)
+void IsFreshBranch::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-	const auto& branches = ex.path().branches();
-
-	for (auto const& bidx: cidxs) {
-		branch_id_t bid = branches[bidx];
-		if (newly_covered_.count(bid) > 0)
+	for (auto const& bid: path.bids()) {
+		if (newly_covered_[bid])
 			checked_cidxs_.push_back(true);
 		else
 			checked_cidxs_.push_back(false);
@@ -172,10 +226,9 @@ void IsFreshPartOfPath::UpdateFeatureStateImpl(const ExecStatus& ex_stat)
 	negated_cidx_ = ex_stat.neg_cidx_;
 }
 
-void IsFreshPartOfPath::ComputeFeature(const SymbolicExecution& ex) {
-	const vector<size_t>& cidxs = ex.path().constraints_idx();
-
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
+void IsFreshPartOfPath::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path) {
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
 		if (cidx < negated_cidx_) {
 			checked_cidxs_.push_back(false);
 		} else {
@@ -185,54 +238,74 @@ void IsFreshPartOfPath::ComputeFeature(const SymbolicExecution& ex) {
 }
 
 
-IsVisitedContext::IsVisitedContext(size_t k,
-		map<branch_id_t, set<branch_id_t> >& dominator)
-	: DynamicFeature(), k_(k), dominator_(dominator) {}
+IsVisitedContext::IsVisitedContext(size_t k, ContextIndex& index)
+	: DynamicFeature(), k_(k), index_(index), computed_generation_(0) {
+		assert(k_ <= index_.max_k());
+}
 
 IsVisitedContext::~IsVisitedContext() {}
 
 void IsVisitedContext::UpdateFeatureStateImpl(const ExecStatus& ex_stat)
 {
-	auto context = GetContext(*(ex_stat.ex_), ex_stat.neg_cidx_);
-	ctx_cache_.insert(context);
+	hash_t context = index_.ContextHash(*(ex_stat.ex_), ex_stat.neg_cidx_, k_);
+	if (ctx_cache_.Insert(context))
+		added_.push_back(context);
 }
 
-void IsVisitedContext::ComputeFeature(const SymbolicExecution& ex)
+void IsVisitedContext::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
-		auto ctx = GetContext(ex, cidx);
+	// The first instance to run on a path hashes the contexts for all.
+	size_t first = index_.Reset(path.size(), path.generation(), path.num_shared());
+	if (first < path.size()) {
+		ForEachRowRange(path.size() - first, [&](size_t begin, size_t end) {
+			index_.HashRows(ex, first + begin, first + end);
+		});
+	}
+
+	// A context depends only on the branches up to its constraint, so the
+	// values of the shared prefix can only have become true through the
+	// contexts added since.
+	size_t reuse = 0;
+	if (computed_generation_ + 1 == path.generation())
+		reuse = std::min(path.num_shared(), visited_.size());
+	visited_.resize(path.size());
+
+	ForEachRowRange(path.size(), [&](size_t begin, size_t end) {
+		for (size_t cidx = begin; cidx < end; ++cidx) {
+			hash_t h = index_.hash(cidx, k_);
+			if (cidx < reuse) {
+				if (!visited_[cidx] && !added_.empty())
+					visited_[cidx] = (std::find(added_.begin(), added_.end(), h)
+							!= added_.end());
+			} else {
+				visited_[cidx] = ctx_cache_.Contains(h);
+			}
+		}
+	});
+	added_.clear();
+	computed_generation_ = path.generation();
 
-		if (ctx_cache_.count(ctx) > 0)
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
+		if (visited_[cidx])
 			checked_cidxs_.push_back(true);
 		else
 			checked_cidxs_.push_back(false);
 	}
 }
 
-vector<branch_id_t>
-IsVisitedContext::GetContext(const SymbolicExecution& ex, size_t cidx)
+bool IsVisitedContext::CheckIncremental(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	vector<branch_id_t> context;
-	const vector<branch_id_t>& branches = ex.path().branches();
-	const vector<size_t>& cidxs = ex.path().constraints_idx();
-
-  int bidx = cidxs[cidx];
-  branch_id_t bid = branches[bidx];
-  auto const& dom = dominator_.find(bid)->second;
-
-  context.push_back(bid);
-  bidx--;
-
-  while (bidx >= 0) {
-    if (context.size() >= k_) 
-      break;
-    if (dom.count(branches[bidx]) == 0)
-      context.push_back(branches[bidx]);
-    bidx--;
-  }
-  return context;
+	if ((computed_generation_ != path.generation()) || (visited_.size() != path.size()))
+		return false;
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
+		hash_t h = index_.ContextHash(ex, cidx, k_);
+		if ((h != index_.hash(cidx, k_))
+				|| (ctx_cache_.Contains(h) != (visited_[cidx] != 0)))
+			return false;
+	}
+	return true;
 }
 
 IsFrequentlySelectedPair::IsFrequentlySelectedPair(size_t k)
@@ -242,18 +315,21 @@ IsFrequentlySelectedPair::~IsFrequentlySelectedPair() {}
 
 void IsFrequentlySelectedPair::UpdateFeatureStateImpl(const ExecStatus& ex_stat)
 {
+	if (ex_stat.neg_cidx_ >= cidx_counter_.size())
+		cidx_counter_.resize(ex_stat.neg_cidx_ + 1, 0);
 	cidx_counter_[ex_stat.neg_cidx_]++;
+	if (static_cast<size_t>(ex_stat.neg_bid_) >= bid_counter_.size())
+		bid_counter_.resize(ex_stat.neg_bid_ + 1, 0);
 	bid_counter_[ex_stat.neg_bid_]++;
 }
 
-void IsFrequentlySelectedPair::ComputeFeature(const SymbolicExecution& ex)
+void IsFrequentlySelectedPair::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-	const auto& branches = ex.path().branches();
-	
-	for (size_t cidx = 0; cidx < cidxs.size(); ++cidx) {
-		branch_id_t bid = branches[cidxs[cidx]];
-		if ((cidx_counter_[cidx] > k_) && (bid_counter_[bid] > k_))
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
+		size_t bid = path.bids()[cidx];
+		if ((cidx < cidx_counter_.size()) && (cidx_counter_[cidx] > k_)
+				&& (bid < bid_counter_.size()) && (bid_counter_[bid] > k_))
 			checked_cidxs_.push_back(true);
 		else
 			checked_cidxs_.push_back(false);
@@ -269,14 +345,14 @@ void IsNearNegatedBefore::UpdateFeatureStateImpl(const ExecStatus& ex_stat) {
 	negated_cidx_ = ex_stat.neg_cidx_;
 }
 
-void IsNearNegatedBefore::ComputeFeature(const SymbolicExecution& ex)
+void IsNearNegatedBefore::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
 	double ratio = 0.2;
-	int lower = negated_cidx_ - (ex.path().constraints_idx().size() * ratio);
-	int upper = negated_cidx_ + (ex.path().constraints_idx().size() * ratio);
+	int lower = negated_cidx_ - (path.size() * ratio);
+	int upper = negated_cidx_ + (path.size() * ratio);
 	
-	for (int cidx = 0; cidx < cidxs.size(); ++cidx) { 
+	for (int cidx = 0; cidx < path.size(); ++cidx) { 
 		if (cidx >= lower || cidx <= upper)
 			checked_cidxs_.push_back(true);
 		else
@@ -293,13 +369,10 @@ IsFrequentlyUnsatBranch::IsFrequentlyUnsatBranch(
 
 IsFrequentlyUnsatBranch::~IsFrequentlyUnsatBranch() {}
 
-void IsFrequentlyUnsatBranch::ComputeFeature(const SymbolicExecution& ex)
+void IsFrequentlyUnsatBranch::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-	const auto& branches = ex.path().branches();
-	
-	for (auto cit = cidxs.begin(); cit != cidxs.end(); ++cit) {
-		branch_id_t bid = branches[*cit];
+	for (auto const& bid: path.bids()) {
 		int unsat_count;
 		if (look_pair_)
 			unsat_count = bid_unsat_count_[paired_branches_[bid]];
@@ -315,77 +388,38 @@ void IsFrequentlyUnsatBranch::ComputeFeature(const SymbolicExecution& ex)
 
 
 IsPairedBranchUncovered::IsPairedBranchUncovered(
-		const vector<vector<branch_id_t> >& cfg,
+		ReachIndex& reach,
 		const vector<bool>& total_covered,
-		const vector<int>& paired_branches,
-		const vector<branch_id_t>& branches,
 		const int depth)
 	: DynamicFeature(),
-		total_covered_(total_covered) {
-
-	for (auto const &br: branches) {
-		branch_id_t bid = br;
-		set<branch_id_t> paired;
-		paired.insert(paired_branches[bid]);
-
-		branches_upto_depth_[bid] = paired;
-	}
-
-	for (auto &kv: branches_upto_depth_) {
-		int current_depth = 0;
-
-		auto key = kv.first;
-		auto value = kv.second;
-		set<branch_id_t> collected(value);
-		vector<branch_id_t> to_collect(value.begin(), value.end());
-
-		while (current_depth++ < depth) {
-			vector<branch_id_t> next_branches;
-			for (auto const &branch: to_collect) {
-				for (auto const &next_branch: cfg[branch]) {
-					next_branches.push_back(next_branch);
-					collected.insert(next_branch);
-				}
-			}
-			to_collect.swap(next_branches);
-		}
-
-		branches_upto_depth_[key] = collected;
-	}
+		total_covered_(total_covered), reach_(reach), depth_(depth) {
+	reach.Prepare(depth_);
 }
 
-
 IsPairedBranchUncovered::~IsPairedBranchUncovered() {}
 
-void IsPairedBranchUncovered::ComputeFeature(const SymbolicExecution& ex)
+void IsPairedBranchUncovered::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& branches = ex.path().branches();
-	const auto& cidxs = ex.path().constraints_idx();
-
-	map<branch_id_t, bool> branch_to_predicate;
-
-	set<branch_id_t> branches_in_path;
-
-	for (const auto& cidx: cidxs) {
-		branch_id_t bid = branches[cidx];
-		branches_in_path.insert(bid);
-	}
-
-	for (const auto& bid: branches_in_path) {
-		const auto& bids = branches_upto_depth_[bid];
-		bool check_uncovered_all = true;
-		for (const auto& br: bids) {
-			if (total_covered_[br]) {
-				check_uncovered_all = false;
-				break;
+	const auto& distinct = path.distinct_bids();
+	vector<char> branch_to_predicate(distinct.size());
+
+	ForEachRowRange(distinct.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			bool check_uncovered_all = true;
+			const branch_id_t* reach_end = reach_.end(distinct[i], depth_);
+			for (const branch_id_t* br = reach_.begin(distinct[i], depth_); br != reach_end; ++br) {
+				if (total_covered_[*br]) {
+					check_uncovered_all = false;
+					break;
+				}
 			}
+			branch_to_predicate[i] = check_uncovered_all;
 		}
-		branch_to_predicate[bid] = check_uncovered_all;
-	}
+	});
 
-	for (const auto& cidx: cidxs) {
-		branch_id_t bid = branches[cidx];
-		if (branch_to_predicate[bid])
+	for (const auto& slot: path.slots()) {
+		if (branch_to_predicate[slot])
 			checked_cidxs_.push_back(true);
 		else
 			checked_cidxs_.push_back(false);
@@ -409,29 +443,19 @@ void IsRecentlySelectedBranch::UpdateFeatureStateImpl(const ExecStatus& ex_stat)
 	bid_history_.push_back(bid);
 }
 
-void IsRecentlySelectedBranch::ComputeFeature(const SymbolicExecution& ex)
+void IsRecentlySelectedBranch::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& branches = ex.path().branches();
-	const auto& cidxs = ex.path().constraints_idx();
-	map<branch_id_t, bool> bid_to_predicate;
-	set<branch_id_t> bids_in_path;
-	set<branch_id_t> bids_in_history(bid_history_.begin(), bid_history_.end());
+	const auto& distinct = path.distinct_bids();
+	vector<bool> bid_to_predicate(distinct.size());
 
-	for (auto const& cidx: cidxs) {
-		branch_id_t bid = branches[cidx];
-		bids_in_path.insert(bid);
-	}
-	
-	for (auto const& bid: bids_in_path) {
-		if (bids_in_history.count(bid)) 
-			bid_to_predicate[bid] = true;
-		else
-			bid_to_predicate[bid] = false;
+	for (size_t i = 0; i < distinct.size(); ++i) {
+		bid_to_predicate[i] = (std::find(bid_history_.begin(), bid_history_.end(),
+					distinct[i]) != bid_history_.end());
 	}
 
-	for (auto const& cidx: cidxs) {
-		branch_id_t bid = branches[cidx];
-		if (bid_to_predicate[bid]) {
+	for (auto const& slot: path.slots()) {
+		if (bid_to_predicate[slot]) {
 			checked_cidxs_.push_back(true);
 		} else {
 			checked_cidxs_.push_back(false);
@@ -439,54 +463,38 @@ void IsRecentlySelectedBranch::ComputeFeature(const SymbolicExecution& ex)
 	}
 }
 
-IsInMostUncoveredFunc::IsInMostUncoveredFunc(
-		const vector<bool>& total_covered,
-		const vector<unsigned int>& branch_function,
-		map<unsigned int, set<branch_id_t> >& fid_branches_map)
-	: DynamicFeature(), total_covered_(total_covered),
-		branch_function_(branch_function), fid_branches_map_(fid_branches_map) {}
+IsInMostUncoveredFunc::IsInMostUncoveredFunc(const vector<bool>& total_covered)
+	: DynamicFeature(), total_covered_(total_covered) {}
 
 IsInMostUncoveredFunc::~IsInMostUncoveredFunc() {}
 
 void IsInMostUncoveredFunc::UpdateFeatureStateImpl(const ExecStatus& ex_stat) {}
 
 	
-void IsInMostUncoveredFunc::ComputeFeature(const SymbolicExecution& ex)
+void IsInMostUncoveredFunc::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-	const auto& branches = ex.path().branches();
-
-	set<branch_id_t> covered_bids;
-	set<int> fids_in_path;
-
-	for (const auto& bidx: cidxs) {
-		branch_id_t bid = branches[bidx];
-		if (total_covered_[bid]) {
-			covered_bids.insert(bid);
-
-			int fid = branch_function_[bid];
-			fids_in_path.insert(fid);
-		}
-	}
-	
-	int largest = 0;
+	const auto& bids = path.bids();
+	const auto& fids = path.fids();
+
+	// Of the functions of the path's covered branches, this selects the
+	// one with the largest id (0 if there is none): the search for the
+	// function with the most uncovered branches never raised its bound,
+	// so every candidate replaced the last, and the learned weights were
+	// trained that way.
+	bool found = false;
 	int most_uncovered_fid = 0;
-	for (const auto& fid: fids_in_path) {
-		set<branch_id_t> bids_in_func = fid_branches_map_[fid];
-		vector<branch_id_t> uncovered(bids_in_func.size());
-		auto sit = std::set_difference(bids_in_func.begin(), bids_in_func.end(),
-				covered_bids.begin(), covered_bids.end(), uncovered.begin());
-		uncovered.resize(sit - uncovered.begin());
-
-		int num_uncovered = uncovered.size();
-		if (num_uncovered >= largest) {
-			most_uncovered_fid = fid;
+	for (size_t cidx = 0; cidx < path.size(); ++cidx) {
+		if (total_covered_[bids[cidx]]) {
+			int fid = fids[cidx];
+			if (!found || fid > most_uncovered_fid)
+				most_uncovered_fid = fid;
+			found = true;
 		}
 	}
 
-	for (auto const& bidx: cidxs) {
-		branch_id_t bid = branches[bidx];
-		int fid = branch_function_[bid];
+	for (auto const& fid_u: fids) {
+		int fid = fid_u;
 
 		if (fid == most_uncovered_fid)
 			checked_cidxs_.push_back(true);
@@ -496,86 +504,62 @@ void IsInMostUncoveredFunc::ComputeFeature(const SymbolicExecution& ex)
 }
 
 IsNearUncovered_Function::IsNearUncovered_Function(
-		const vector<vector<branch_id_t> >& cfg,
-		const vector<bool>& total_covered,
+		ReachIndex& reach,
 		const vector<int>& paired_branches,
-		const vector<branch_id_t>& branches,
 		const int depth,
-		map<unsigned int, set<branch_id_t> >& fid_branches_map,
-		set<function_id_t>& uncovered_function_id,
-		int threshold)
-	: DynamicFeature(), total_covered_(total_covered), paired_branches_(paired_branches),  
-	                    fid_branches_map_(fid_branches_map), uncovered_function_id_(uncovered_function_id), threshold_(threshold){
-
-	for (auto const &br: branches) {
-		branch_id_t bid = br;
-		set<branch_id_t> paired;
-		paired.insert(paired_branches[bid]);
-
-		branches_upto_depth_[bid] = paired;
-	}
-
-	for (auto &kv: branches_upto_depth_) {
-		int current_depth = 0;
-
-		auto key = kv.first;
-		auto value = kv.second;
-		set<branch_id_t> collected(value);
-		vector<branch_id_t> to_collect(value.begin(), value.end());
-
-		while (current_depth++ < depth) {
-			vector<branch_id_t> next_branches;
-			for (auto const &branch: to_collect) {
-				for (auto const &next_branch: cfg[branch]) {
-					next_branches.push_back(next_branch);
-					collected.insert(next_branch);
-				}
-			}
-			to_collect.swap(next_branches);
-		}
-
-		branches_upto_depth_[key] = collected;
-	}
+		const vector<size_t>& fid_branch_begin,
+		const vector<branch_id_t>& fid_branches,
+		const vector<function_id_t>& uncovered_function_id,
+		const int& threshold)
+	: DynamicFeature(), reach_(reach), depth_(depth),
+		fid_branch_begin_(fid_branch_begin), fid_branches_(fid_branches),
+		uncovered_function_id_(uncovered_function_id), paired_branches_(paired_branches),
+		threshold_(threshold) {
+	reach.Prepare(depth_);
 	}
 
 
 IsNearUncovered_Function::~IsNearUncovered_Function() {}
 
-void IsNearUncovered_Function::ComputeFeature(const SymbolicExecution& ex)
+void IsNearUncovered_Function::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& branches = ex.path().branches();
-	const auto& cidxs = ex.path().constraints_idx();
+	const auto& distinct = path.distinct_bids();
+	vector<char> branch_to_predicate(distinct.size());
 
-	map<branch_id_t, bool> branch_to_predicate;
-
-	set<branch_id_t> branches_in_path;
-	branches_in_uncovered_func.clear();
+	for (const auto& bid: marked_branches_)
+		in_uncovered_func_[bid] = 0;
+	marked_branches_.clear();
 	for(const auto& fun_id: uncovered_function_id_){
-		set<branch_id_t> bids_in_func = fid_branches_map_[fun_id];
-		if(bids_in_func.size()>=threshold_){
-        		set<branch_id_t>::iterator it = bids_in_func.begin();
-			branches_in_uncovered_func.insert(*it);
-			branches_in_uncovered_func.insert(paired_branches_[*it]);
+		size_t begin = fid_branch_begin_[fun_id];
+		size_t num_bids = fid_branch_begin_[fun_id + 1] - begin;
+		if((num_bids > 0) && (num_bids >= threshold_)){
+			branch_id_t bid = fid_branches_[begin];
+			marked_branches_.push_back(bid);
+			marked_branches_.push_back(paired_branches_[bid]);
 		}
 	}
-	for (const auto& cidx: cidxs) {
-		branch_id_t bid = branches[cidx];
-		branches_in_path.insert(bid);
-	}
-	for (const auto& bid: branches_in_path) {
-		const auto& bids = branches_upto_depth_[bid];
-		bool check_uncovered_all = false;
-		for (const auto& br: bids) {
-			if (branches_in_uncovered_func.count(br)>0) {
-				check_uncovered_all = true;
-				break;
+	for (const auto& bid: marked_branches_) {
+		if (static_cast<size_t>(bid) >= in_uncovered_func_.size())
+			in_uncovered_func_.resize(bid + 1, 0);
+		in_uncovered_func_[bid] = 1;
+	}
+	ForEachRowRange(distinct.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			bool check_uncovered_all = false;
+			const branch_id_t* reach_end = reach_.end(distinct[i], depth_);
+			for (const branch_id_t* br = reach_.begin(distinct[i], depth_); br != reach_end; ++br) {
+				if ((static_cast<size_t>(*br) < in_uncovered_func_.size())
+						&& in_uncovered_func_[*br]) {
+					check_uncovered_all = true;
+					break;
+				}
 			}
+			branch_to_predicate[i] = check_uncovered_all;
 		}
-		branch_to_predicate[bid] = check_uncovered_all;
-	}
-	for (const auto& cidx: cidxs) {
-		branch_id_t bid = branches[cidx];
-		if (branch_to_predicate[bid])
+	});
+	for (const auto& slot: path.slots()) {
+		if (branch_to_predicate[slot])
 			checked_cidxs_.push_back(true);
 		else
 			checked_cidxs_.push_back(false);
@@ -583,11 +567,10 @@ void IsNearUncovered_Function::ComputeFeature(const SymbolicExecution& ex)
 }
 
 IsInLatestCoveredFunc::IsInLatestCoveredFunc(
-		const vector<unsigned int>& branch_function,
-		map<unsigned int, set<branch_id_t> >& fid_branches_map,
-		const set<unsigned int>& latest_covered_fid)
-	: DynamicFeature(), branch_function_(branch_function),
-		fid_branches_map_(fid_branches_map), latest_covered_fid_(latest_covered_fid) {}
+		const vector<size_t>& fid_branch_begin,
+		const vector<function_id_t>& latest_covered_fid)
+	: DynamicFeature(),
+		fid_branch_begin_(fid_branch_begin), latest_covered_fid_(latest_covered_fid) {}
 
 IsInLatestCoveredFunc::~IsInLatestCoveredFunc() {}
 
@@ -596,36 +579,43 @@ void IsInLatestCoveredFunc::UpdateFeatureStateImpl(const ExecStatus& ex_stat)
 	int count = 10;
 
 	for (const auto& fid: latest_covered_fid_) {
+		if (fid >= fid_to_exec_counter_.size()) {
+			fid_to_exec_counter_.resize(fid + 1, -1);
+			latest_fids_.resize(fid + 1, 0);
+		}
+		if (fid_to_exec_counter_[fid] < 0)
+			counted_fids_.push_back(fid);
 		fid_to_exec_counter_[fid] = count;
 	}
 
-	for (auto& kv: fid_to_exec_counter_) {
-		unsigned int fid = kv.first;
-		int count = kv.second;
+	// A counter of -1 means none; the others are kept in counted_fids_.
+	size_t num_kept = 0;
+	for (size_t i = 0; i < counted_fids_.size(); ++i) {
+		function_id_t fid = counted_fids_[i];
+		int& count = fid_to_exec_counter_[fid];
 
-		if ((fid_branches_map_[fid]).size() < 10)
+		if (fid_branch_begin_[fid + 1] - fid_branch_begin_[fid] < 10) {
+			counted_fids_[num_kept++] = fid;
 			continue;
+		}
 
 		if (count > 0) {
-			latest_fids_.insert(fid);
-			fid_to_exec_counter_[fid]--;
+			latest_fids_[fid] = 1;
+			count--;
+			counted_fids_[num_kept++] = fid;
 		} else {
-			latest_fids_.erase(fid);
-			fid_to_exec_counter_.erase(fid);
+			latest_fids_[fid] = 0;
+			count = -1;
 		}
 	}
+	counted_fids_.resize(num_kept);
 }
 
-void IsInLatestCoveredFunc::ComputeFeature(const SymbolicExecution& ex)
+void IsInLatestCoveredFunc::ComputeFeature(const SymbolicExecution& ex,
+		const PathSummary& path)
 {
-	const auto& cidxs = ex.path().constraints_idx();
-	const auto& branches = ex.path().branches();
-
-	for (auto const& bidx: cidxs) {
-		branch_id_t bid = branches[bidx];
-		unsigned int fid = branch_function_[bid];
-
-		if (latest_fids_.count(fid) > 0) {
+	for (auto const& fid: path.fids()) {
+		if ((fid < latest_fids_.size()) && latest_fids_[fid]) {
 			checked_cidxs_.push_back(true);
 		} else {
 			checked_cidxs_.push_back(false);
@@ -11,6 +11,9 @@
 
 #include "base/basic_types.h"
 #include "base/symbolic_execution.h"
+#include "run_crest/context_index.h"
+#include "run_crest/reach_index.h"
+#include "run_crest/row_pool.h"
 
 
 using std::map;
@@ -30,67 +33,154 @@ typedef struct exec_status {
 ExecStatus GenExecStatus(SymbolicExecution* ex,
 		size_t neg_cidx, branch_id_t neg_bid, bool prediction_failure);
 
+// What the dynamic features need to know about a path, gathered in one
+// pass over it so that each feature is a cheap lookup per constraint
+// instead of its own walk building maps and sets.
+class PathSummary {
+ public:
+	PathSummary();
+
+	void Build(const SymbolicExecution& ex,
+			const vector<unsigned int>& branch_function);
+
+	// The number of constraints on the path.
+	size_t size() const { return bids_.size(); }
+
+	// The branch, and that branch's function, of each constraint.
+	const vector<branch_id_t>& bids() const { return bids_; }
+	const vector<unsigned int>& fids() const { return fids_; }
+
+	// The distinct branches of the constraints (in order of appearance),
+	// and the index in it of each constraint's branch.
+	const vector<branch_id_t>& distinct_bids() const { return distinct_bids_; }
+	const vector<size_t>& slots() const { return slots_; }
+
+	// Build numbers this summary; the one built before has generation()-1.
+	unsigned long generation() const { return generation_; }
+
+	// The number of leading constraints that are the same as on the path
+	// summarized before -- same position and every branch up to theirs --
+	// e.g. the prefix before the negated branch when a prediction held.
+	size_t num_shared() const { return num_shared_; }
+
+	// How often 'bid' occurs among the first size() branches of the path
+	// (all branches, not just those of constraints), and the largest such
+	// count.  These are what the path-frequency features compare.
+	size_t prefix_count(branch_id_t bid) const {
+		return (static_cast<size_t>(bid) < prefix_count_.size()) ? prefix_count_[bid] : 0;
+	}
+	size_t max_prefix_count() const { return max_prefix_count_; }
+
+ private:
+	vector<branch_id_t> bids_;
+	vector<unsigned int> fids_;
+	vector<branch_id_t> distinct_bids_;
+	vector<size_t> slots_;
+
+	unsigned long generation_;
+	size_t num_shared_;
+	vector<size_t> prev_cidxs_;
+	vector<branch_id_t> prev_branches_;
+
+	// Indexed by branch id; only the entries of the current path's
+	// branches are non-zero (resp. current).
+	vector<size_t> prefix_count_;
+	vector<size_t> slot_of_;
+	vector<unsigned int> slot_stamp_;
+	unsigned int stamp_;
+	vector<branch_id_t> counted_;
+	size_t max_prefix_count_;
+};
+
 class DynamicFeature {
  public:
 	DynamicFeature();
 	~DynamicFeature();
 	virtual void UpdateFeatureState(const ExecStatus& ex_stat);
 	virtual void UpdateFeatureStateImpl(const ExecStatus& ex_stat);
-	virtual void ComputeFeature(const SymbolicExecution& ex) = 0;
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path) = 0;
 	bool Predicate(size_t cidx);
 	bool IsReadyToCompute() { return ready_; }
 
+	// True if the feature's value at a constraint depends only on the
+	// path up to it and on the feature's own state.  ComputeFeature may
+	// then reuse its previous values for the PathSummary::num_shared()
+	// leading constraints, adjusted for its state changes since.
+	virtual bool IsPrefixStable() const { return false; }
+
+	// For prefix-stable features: recomputes the values last stored by
+	// ComputeFeature for 'ex' from scratch, and returns true if they are
+	// identical.
+	virtual bool CheckIncremental(const SymbolicExecution& ex,
+			const PathSummary& path) { return true; }
+
+	// Lets the features split their loops over large paths across the
+	// threads of 'pool' (not owned; NULL runs them serially).
+	static void SetRowPool(RowPool* pool) { row_pool_ = pool; }
+
 	int feature_idx_;
 
  protected:
 	bool ready_;
 	vector<bool> checked_cidxs_;
 	static int feature_counter_;
+	static RowPool* row_pool_;
+
+	// Calls fn(begin, end) on a partition of [0, n), on the row pool if
+	// there is one.  'fn' may only write rows in [begin, end).
+	static void ForEachRowRange(size_t n, const RowPool::RangeFn& fn);
 };
 	
 class IsFrontBranch : public DynamicFeature {
  public:
 	IsFrontBranch();
 	~IsFrontBranch();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 };
 
 class IsEndBranch : public DynamicFeature {
  public:
 	IsEndBranch();
 	~IsEndBranch();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 };
 
 class IsMostFrequentlyAppearedInPath : public DynamicFeature {
  public:
 	IsMostFrequentlyAppearedInPath();
 	~IsMostFrequentlyAppearedInPath();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 };
 
 class IsLeastFrequentlyAppearedInPath : public DynamicFeature {
  public:
 	IsLeastFrequentlyAppearedInPath();
 	~IsLeastFrequentlyAppearedInPath();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 };
 
 class IsFreshBranch : public DynamicFeature {
  public:
-	IsFreshBranch(const set<branch_id_t>& newly_covered);
+	IsFreshBranch(const vector<bool>& newly_covered);
 	~IsFreshBranch();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
-	const set<branch_id_t>& newly_covered_;
+	const vector<bool>& newly_covered_;
 };
 
 class IsFreshPartOfPath : public DynamicFeature {
  public:
 	IsFreshPartOfPath();
 	~IsFreshPartOfPath();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 	virtual void UpdateFeatureStateImpl(const ExecStatus& ex_stat);
 
  private:
@@ -100,19 +190,26 @@ class IsFreshPartOfPath : public DynamicFeature {
 
 class IsVisitedContext : public DynamicFeature {
  public:
-	IsVisitedContext(size_t k, 
-			map<branch_id_t, set<branch_id_t> >&	dominator);
+	IsVisitedContext(size_t k, ContextIndex& index);
 	~IsVisitedContext();
 	virtual void UpdateFeatureStateImpl(const ExecStatus& ex_stat);
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
+	virtual bool IsPrefixStable() const { return true; }
+	virtual bool CheckIncremental(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
-	typedef vector<branch_id_t> ctx_t;
 	size_t k_;
-	map<branch_id_t, set<branch_id_t> >& dominator_;
-	set<ctx_t> ctx_cache_;
-
-	ctx_t GetContext(const SymbolicExecution& ex, size_t cidx);
+	ContextIndex& index_;  // shared by all k
+	ContextSet ctx_cache_;
+
+	// The value of each constraint of the path last computed (in summary
+	// generation 'computed_generation_'), and the contexts added to
+	// ctx_cache_ since.
+	vector<char> visited_;
+	unsigned long computed_generation_;
+	vector<hash_t> added_;
 };
 
 class IsFrequentlySelectedPair : public DynamicFeature {
@@ -120,12 +217,14 @@ class IsFrequentlySelectedPair : public DynamicFeature {
 	IsFrequentlySelectedPair(size_t k);
 	~IsFrequentlySelectedPair();
 	virtual void UpdateFeatureStateImpl(const ExecStatus& ex_stat);
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
 	const size_t k_;
-	map<size_t, size_t> cidx_counter_;
-	map<branch_id_t, size_t> bid_counter_;
+	// Times each position and branch was negated, grown on demand.
+	vector<size_t> cidx_counter_;
+	vector<size_t> bid_counter_;
 };
 
 class IsNearNegatedBefore : public DynamicFeature {
@@ -133,7 +232,8 @@ class IsNearNegatedBefore : public DynamicFeature {
 	IsNearNegatedBefore();
 	~IsNearNegatedBefore();
 	virtual void UpdateFeatureStateImpl(const ExecStatus& ex_stat);
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
 	size_t negated_cidx_;
@@ -146,7 +246,8 @@ class IsFrequentlyUnsatBranch : public DynamicFeature {
 			const vector<branch_id_t>& paired_branches,
 			bool look_pair);
 	~IsFrequentlyUnsatBranch();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
 	const vector<int>& bid_unsat_count_;	
@@ -158,17 +259,17 @@ class IsFrequentlyUnsatBranch : public DynamicFeature {
 class IsPairedBranchUncovered : public DynamicFeature {
  public:
 	IsPairedBranchUncovered(
-			const vector<vector<branch_id_t> >& cfg,
+			ReachIndex& reach,
 			const vector<bool>& total_covered,
-			const vector<int>& paired_branches,
-			const vector<branch_id_t>& branches,
 			const int depth);
 	~IsPairedBranchUncovered();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
 	const vector<bool>& total_covered_;
-	map<branch_id_t, set<branch_id_t> > branches_upto_depth_;
+	const ReachIndex& reach_;
+	const size_t depth_;
 };
 
 class IsRecentlySelectedBranch : public DynamicFeature {
@@ -176,7 +277,8 @@ class IsRecentlySelectedBranch : public DynamicFeature {
 	IsRecentlySelectedBranch(const int k);
 	~IsRecentlySelectedBranch();
 	virtual void UpdateFeatureStateImpl(const ExecStatus& ex_stat);
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
 	const int k_;
@@ -185,61 +287,65 @@ class IsRecentlySelectedBranch : public DynamicFeature {
 
 class IsInMostUncoveredFunc : public DynamicFeature {
  public:
-	IsInMostUncoveredFunc(
-			const vector<bool>& total_covered,
-			const vector<unsigned int>& branch_function,
-			map<unsigned int, set<branch_id_t> >& fid_branches_map);
+	IsInMostUncoveredFunc(const vector<bool>& total_covered);
 	~IsInMostUncoveredFunc();
 	virtual void UpdateFeatureStateImpl(const ExecStatus& ex_stat);
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
 	const vector<bool>& total_covered_;
-	const vector<unsigned int>& branch_function_;
-	map<unsigned int, set<branch_id_t> >& fid_branches_map_;
 };
 
 class IsNearUncovered_Function : public DynamicFeature {
  public:
 	IsNearUncovered_Function(
-			const vector<vector<branch_id_t> >& cfg,
-			const vector<bool>& total_covered,
+			ReachIndex& reach,
 			const vector<int>& paired_branches,
-			const vector<branch_id_t>& branches,
 			const int depth,
-			map<unsigned int, set<branch_id_t> >& fid_branches_map,
-			set<function_id_t>& uncovered_function_id,
-			const int threshold);
+			const vector<size_t>& fid_branch_begin,
+			const vector<branch_id_t>& fid_branches,
+			const vector<function_id_t>& uncovered_function_id,
+			const int& threshold);
 			
 	~IsNearUncovered_Function();
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
-	const vector<bool>& total_covered_;
-	map<branch_id_t, set<branch_id_t> > branches_upto_depth_;
-	map<unsigned int, set<branch_id_t> >& fid_branches_map_;
-	set<function_id_t>& uncovered_function_id_;
-	set<branch_id_t> branches_in_uncovered_func;    
+	const ReachIndex& reach_;
+	const size_t depth_;
+	const vector<size_t>& fid_branch_begin_;
+	const vector<branch_id_t>& fid_branches_;
+	const vector<function_id_t>& uncovered_function_id_;
+	// Marks (indexed by branch id) of the branches listed in
+	// marked_branches_.
+	vector<char> in_uncovered_func_;
+	vector<branch_id_t> marked_branches_;
 	const vector<int>& paired_branches_;
-	int threshold_;
+	// The fewest branches a function needs to count, read on every
+	// computation (the search keeps it up to date).
+	const int& threshold_;
 };
 
 class IsInLatestCoveredFunc : public DynamicFeature {
  public:
 	IsInLatestCoveredFunc(
-			const vector<unsigned int>& branch_function,
-			map<unsigned int, set<branch_id_t> >& fid_branches_map,
-			const set<unsigned int>& latest_covered_fid);
+			const vector<size_t>& fid_branch_begin,
+			const vector<function_id_t>& latest_covered_fid);
 	~IsInLatestCoveredFunc();
 	virtual void UpdateFeatureStateImpl(const ExecStatus& ex_stat);
-	virtual void ComputeFeature(const SymbolicExecution& ex);
+	virtual void ComputeFeature(const SymbolicExecution& ex,
+			const PathSummary& path);
 
  private:
-	const vector<unsigned int>& branch_function_;
-	map<unsigned int, set<branch_id_t> >& fid_branches_map_;
-	const set<unsigned int>& latest_covered_fid_;
-	map<unsigned int, int> fid_to_exec_counter_;
-	set<unsigned int> latest_fids_;
+	const vector<size_t>& fid_branch_begin_;
+	const vector<function_id_t>& latest_covered_fid_;
+	// The functions with a countdown (fid_to_exec_counter_, indexed by
+	// function id), and the marks of the latest functions.
+	vector<function_id_t> counted_fids_;
+	vector<int> fid_to_exec_counter_;
+	vector<char> latest_fids_;
 };
 
 }
@@ -0,0 +1,52 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <assert.h>
+
+#include "run_crest/rank_index.h"
+
+namespace crest {
+
+RankIndex::RankIndex(size_t max_value) {
+  Reset(max_value);
+}
+
+void RankIndex::Reset(size_t max_value) {
+  tree_.assign(max_value + 2, 0);
+  top_bit_ = 1;
+  while (2 * top_bit_ < tree_.size())
+    top_bit_ *= 2;
+  size_ = 0;
+}
+
+void RankIndex::Add(size_t v, long delta) {
+  assert(v + 1 < tree_.size());
+  for (size_t i = v + 1; i < tree_.size(); i += i & (~i + 1)) {
+    tree_[i] += delta;
+  }
+  size_ += delta;
+}
+
+size_t RankIndex::Select(size_t r) const {
+  assert((r >= 1) && (r <= size_));
+  // Descend to the largest position whose prefix count is below r.
+  size_t pos = 0;
+  long rem = r;
+  for (size_t step = top_bit_; step > 0; step /= 2) {
+    if ((pos + step < tree_.size()) && (tree_[pos + step] < rem)) {
+      pos += step;
+      rem -= tree_[pos];
+    }
+  }
+  // Position pos + 1 holds value pos.
+  return pos;
+}
+
+}  // namespace crest
@@ -0,0 +1,50 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef RUN_CREST_RANK_INDEX_H__
+#define RUN_CREST_RANK_INDEX_H__
+
+#include <stddef.h>
+#include <vector>
+
+using std::vector;
+
+namespace crest {
+
+// A multiset of the integers 0..max_value, in a Fenwick tree of counts:
+// inserting, erasing, and finding the r-th smallest element each take
+// O(log max_value).
+class RankIndex {
+ public:
+  explicit RankIndex(size_t max_value = 0);
+
+  // Empties the set, which may then hold 0..max_value.
+  void Reset(size_t max_value);
+
+  void Insert(size_t v) { Add(v, 1); }
+  void Erase(size_t v) { Add(v, -1); }
+
+  size_t size() const { return size_; }
+
+  // The r-th smallest element, for r = 1..size().
+  size_t Select(size_t r) const;
+
+ private:
+  void Add(size_t v, long delta);
+
+  // tree_[i] counts the elements in (i - lowbit(i), i], shifted by one.
+  vector<long> tree_;
+  size_t top_bit_;
+  size_t size_;
+};
+
+}  // namespace crest
+
+#endif  // RUN_CREST_RANK_INDEX_H__
@@ -0,0 +1,101 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <algorithm>
+#include <assert.h>
+
+#include "run_crest/reach_index.h"
+
+namespace crest {
+
+ReachIndex::ReachIndex() : succ_begin_(1, 0) { }
+
+void ReachIndex::SetCfg(const vector<vector<branch_id_t> >& cfg,
+                        const vector<branch_id_t>& paired_branches,
+                        const vector<branch_id_t>& branches) {
+  succ_begin_.assign(cfg.size() + 1, 0);
+  succs_.clear();
+  for (size_t b = 0; b < cfg.size(); b++) {
+    succ_begin_[b] = succs_.size();
+    succs_.insert(succs_.end(), cfg[b].begin(), cfg[b].end());
+  }
+  succ_begin_[cfg.size()] = succs_.size();
+
+  paired_ = paired_branches;
+  branches_ = branches;
+  near_.clear();
+}
+
+void ReachIndex::Prepare(size_t depth) {
+  if (depth >= near_.size())
+    near_.resize(depth + 1);
+  Rows& r = near_[depth];
+  if (!r.begin.empty())
+    return;
+
+  branch_id_t max_bid = -1;
+  for (size_t i = 0; i < branches_.size(); i++) {
+    max_bid = std::max(max_bid, branches_[i]);
+  }
+  vector<branch_id_t> sorted(branches_);
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+  // Breadth-first from each paired branch, marking the branches seen
+  // with the index of the search.
+  const size_t num_nodes = succ_begin_.size() - 1;
+  vector<size_t> seen(num_nodes, 0);
+  vector<branch_id_t> frontier, next, found;
+  r.begin.assign(max_bid + 2, 0);
+  size_t search = 0;
+  vector<branch_id_t>::const_iterator it = sorted.begin();
+  for (branch_id_t b = 0; b <= max_bid; b++) {
+    r.begin[b] = r.bids.size();
+    if ((it == sorted.end()) || (*it != b))
+      continue;
+    ++it;
+    ++search;
+
+    branch_id_t p = paired_[b];
+    assert((p >= 0) && (static_cast<size_t>(p) < num_nodes));
+    seen[p] = search;
+    found.assign(1, p);
+    frontier.assign(1, p);
+    for (size_t d = 0; d < depth; d++) {
+      next.clear();
+      for (size_t i = 0; i < frontier.size(); i++) {
+        branch_id_t u = frontier[i];
+        for (size_t j = succ_begin_[u]; j < succ_begin_[u + 1]; j++) {
+          branch_id_t v = succs_[j];
+          assert((v >= 0) && (static_cast<size_t>(v) < num_nodes));
+          if (seen[v] != search) {
+            seen[v] = search;
+            found.push_back(v);
+            next.push_back(v);
+          }
+        }
+      }
+      frontier.swap(next);
+    }
+    std::sort(found.begin(), found.end());
+    r.bids.insert(r.bids.end(), found.begin(), found.end());
+  }
+  r.begin[max_bid + 1] = r.bids.size();
+}
+
+size_t ReachIndex::size() const {
+  size_t n = 0;
+  for (size_t d = 0; d < near_.size(); d++) {
+    n += near_[d].bids.size();
+  }
+  return n;
+}
+
+}  // namespace crest
@@ -0,0 +1,79 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef RUN_CREST_REACH_INDEX_H__
+#define RUN_CREST_REACH_INDEX_H__
+
+#include <vector>
+
+#include "base/basic_types.h"
+
+using std::vector;
+
+namespace crest {
+
+// The branches near each branch's paired branch in the CFG: for a branch
+// b and a depth d, the branches reachable from paired(b) in at most d
+// steps (paired(b) itself included).  The proximity features of -param
+// share one index; each depth is computed once, for every branch listed
+// in the "branches" file, and stored as sorted arrays in compressed
+// rows.  Other branches have no near branches.
+class ReachIndex {
+ public:
+  ReachIndex();
+
+  // Stores 'cfg' (the successors of each branch) in compressed rows.
+  void SetCfg(const vector<vector<branch_id_t> >& cfg,
+              const vector<branch_id_t>& paired_branches,
+              const vector<branch_id_t>& branches);
+
+  // Computes the near branches at 'depth', unless already done.
+  void Prepare(size_t depth);
+
+  // The near branches of 'bid' at 'depth' (which must be prepared), in
+  // increasing order.
+  const branch_id_t* begin(branch_id_t bid, size_t depth) const {
+    const Rows& r = near_[depth];
+    return InRange(bid, r) ? &r.bids.front() + r.begin[bid] : NULL;
+  }
+  const branch_id_t* end(branch_id_t bid, size_t depth) const {
+    const Rows& r = near_[depth];
+    return InRange(bid, r) ? &r.bids.front() + r.begin[bid + 1] : NULL;
+  }
+
+  // Total number of near branches stored, over every prepared depth.
+  size_t size() const;
+
+ private:
+  struct Rows {
+    vector<size_t> begin;  // indexed by branch id, with one extra entry
+    vector<branch_id_t> bids;
+  };
+
+  static bool InRange(branch_id_t bid, const Rows& r) {
+    return (bid >= 0) && (static_cast<size_t>(bid) + 1 < r.begin.size())
+        && !r.bids.empty();
+  }
+
+  // The CFG: the successors of branch b are
+  // succs_[succ_begin_[b], succ_begin_[b+1]).
+  vector<size_t> succ_begin_;
+  vector<branch_id_t> succs_;
+
+  vector<branch_id_t> paired_;
+  vector<branch_id_t> branches_;
+
+  // Indexed by depth; a depth is prepared once its 'begin' is filled.
+  vector<Rows> near_;
+};
+
+}  // namespace crest
+
+#endif  // RUN_CREST_REACH_INDEX_H__
@@ -0,0 +1,102 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <sys/time.h>
+
+#include "run_crest/row_pool.h"
+
+namespace crest {
+
+namespace {
+
+double WallTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+}  // namespace
+
+
+RowPool::RowPool(size_t num_threads, size_t min_rows)
+  : num_threads_(num_threads > 1 ? num_threads : 1),
+    min_rows_(min_rows > num_threads_ ? min_rows : num_threads_),
+    fn_(NULL), n_(0), generation_(0), num_running_(0), stop_(false),
+    num_serial_rows_(0), serial_secs_(0.0),
+    num_parallel_rows_(0), num_parallel_runs_(0), parallel_secs_(0.0) {
+  for (size_t id = 1; id < num_threads_; id++) {
+    threads_.push_back(std::thread(&RowPool::Work, this, id));
+  }
+}
+
+RowPool::~RowPool() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (size_t i = 0; i < threads_.size(); i++) {
+    threads_[i].join();
+  }
+}
+
+void RowPool::Run(size_t n, const RangeFn& fn) {
+  double start = WallTime();
+  if ((num_threads_ == 1) || (n < min_rows_)) {
+    fn(0, n);
+    num_serial_rows_ += n;
+    serial_secs_ += WallTime() - start;
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    fn_ = &fn;
+    n_ = n;
+    generation_++;
+    num_running_ = num_threads_ - 1;
+  }
+  start_.notify_all();
+  RunRange(0);
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (num_running_ > 0)
+      done_.wait(lock);
+    fn_ = NULL;
+  }
+
+  num_parallel_rows_ += n;
+  num_parallel_runs_++;
+  parallel_secs_ += WallTime() - start;
+}
+
+void RowPool::RunRange(size_t id) {
+  (*fn_)(n_ * id / num_threads_, n_ * (id + 1) / num_threads_);
+}
+
+void RowPool::Work(size_t id) {
+  unsigned long seen = 0;
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    while (!stop_ && (generation_ == seen))
+      start_.wait(lock);
+    if (stop_)
+      return;
+    seen = generation_;
+
+    lock.unlock();
+    RunRange(id);
+    lock.lock();
+    if (--num_running_ == 0)
+      done_.notify_one();
+  }
+}
+
+}  // namespace crest
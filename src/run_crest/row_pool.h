@@ -0,0 +1,83 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef RUN_CREST_ROW_POOL_H__
+#define RUN_CREST_ROW_POOL_H__
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+namespace crest {
+
+// Runs loops over the rows of a path (its constraints, or its distinct
+// branches) on a fixed set of threads, one contiguous range of rows per
+// thread.  Each range must write only its own rows and read nothing the
+// others write, so the results are the same for any number of threads.
+// Loops over fewer than 'min_rows' rows run on the calling thread.
+class RowPool {
+ public:
+  typedef std::function<void(size_t begin, size_t end)> RangeFn;
+
+  RowPool(size_t num_threads, size_t min_rows);
+  ~RowPool();
+
+  size_t num_threads() const { return num_threads_; }
+  size_t min_rows() const { return min_rows_; }
+
+  // Calls 'fn' on a partition of [0, n) into ranges, and returns once
+  // every call has returned.
+  void Run(size_t n, const RangeFn& fn);
+
+  // Statistics: rows and wall-clock time of the loops run serially and
+  // in parallel, and the number of parallel loops.
+  unsigned long num_serial_rows() const { return num_serial_rows_; }
+  double serial_secs() const { return serial_secs_; }
+  unsigned long num_parallel_rows() const { return num_parallel_rows_; }
+  unsigned long num_parallel_runs() const { return num_parallel_runs_; }
+  double parallel_secs() const { return parallel_secs_; }
+
+ private:
+  void Work(size_t id);
+  void RunRange(size_t id);
+
+  const size_t num_threads_;
+  const size_t min_rows_;
+  vector<std::thread> threads_;
+
+  // The loop being run (valid while num_running_ > 0), numbered by
+  // generation_; workers 1.. take the ranges after the caller's.
+  std::mutex mu_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const RangeFn* fn_;
+  size_t n_;
+  unsigned long generation_;
+  size_t num_running_;
+  bool stop_;
+
+  unsigned long num_serial_rows_;
+  double serial_secs_;
+  unsigned long num_parallel_rows_;
+  unsigned long num_parallel_runs_;
+  double parallel_secs_;
+
+  // Not copyable.
+  RowPool(const RowPool&);
+  void operator=(const RowPool&);
+};
+
+}  // namespace crest
+
+#endif  // RUN_CREST_ROW_POOL_H__
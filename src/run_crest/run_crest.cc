@@ -10,22 +10,120 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <map>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
 
+#include "base/yices_solver.h"
 #include "run_crest/concolic_search.h"
 
+using std::map;
+
 int main(int argc, char* argv[]) {
+  // Pull out "--name" and "--name=value" options, which may appear
+  // anywhere; the remaining arguments are positional.
+  map<string,string> options;
+  {
+    int n = 1;
+    for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      if (arg.compare(0, 2, "--") != 0) {
+        argv[n++] = argv[i];
+        continue;
+      }
+      size_t eq = arg.find('=');
+      if (eq == string::npos) {
+        options[arg.substr(2)] = "";
+      } else {
+        options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+      }
+    }
+    argc = n;
+  }
+
   if (argc < 4) {
     fprintf(stderr,
             "Syntax: run_crest <program> "
 						"<input file>"
 						"<log file> "
             "<number of iterations or number of seconds e.g.) 1000 or 3600s> "
-            "-<strategy> [strategy options]\n");
+            "-<strategy> [strategy options] [--options]\n");
     fprintf(stderr,
             "  Strategies include: "
             "dfs, cfg, random, uniform_random, random_input, cgs, carfast, generational\n");
+    fprintf(stderr,
+            "  Options include:\n"
+            "    --bitvector_solver    encode variables as bit-vectors of their widths\n"
+            "    --incremental_solver  reuse one solver context across queries\n"
+            "    --fast_solver         answer trivial linear queries without Yices\n"
+            "    --solver_cache        cache solver results within the run\n"
+            "    --solver_cache_dir=D  also share solver results through a file in D\n"
+            "    --solver_workers=N    solve the top N candidates of -param in parallel\n"
+            "    --solver_timeout=S    give up on a solver query after S seconds\n"
+            "    --max_branch_cost=S   avoid branches costing over S solver seconds per answer\n"
+            "    --solver_models=N     retry a missed branch with up to N-1 other models\n"
+            "    --solver_window=N     solve only the last N (or more) constraints of a slice\n"
+            "    --record_queries=F    append every solver query to the query log F\n"
+            "    --check_features      verify incremental -param features against full recomputation\n"
+            "    --feature_threads=N   compute -param features of large paths on N threads\n"
+            "    --feature_min_rows=R  the path length from which --feature_threads applies\n");
+    return 1;
+  }
+
+  int num_solver_workers = 1;
+  double max_branch_cost = 0.0;
+  int num_models = 1;
+  int solver_window = 0;
+  bool check_features = false;
+  int feature_threads = 1;
+  int feature_min_rows = 4096;
+  // The options are applied in two passes: the encoding first, since it
+  // picks the persistent cache file, then the files are opened after the
+  // loop below.
+  if (options.count("bitvector_solver")) {
+    crest::YicesSolver::EnableBitVectors(true);
+    // The program records its predicates without normalizing them.
+    setenv("CREST_EXACT_PREDICATES", "1", 1);
+  }
+  for (map<string,string>::const_iterator i = options.begin(); i != options.end(); ++i) {
+    if ((i->first == "bitvector_solver") || (i->first == "solver_cache_dir")
+        || (i->first == "record_queries")) {
+      // Applied before or after this loop.
+    } else if (i->first == "incremental_solver") {
+      crest::YicesSolver::EnableSession(true);
+    } else if (i->first == "fast_solver") {
+      crest::YicesSolver::EnableFastSolver(true);
+    } else if (i->first == "solver_cache") {
+      crest::YicesSolver::EnableCache(true);
+    } else if (i->first == "solver_workers") {
+      num_solver_workers = atoi(i->second.c_str());
+    } else if (i->first == "solver_timeout") {
+      crest::YicesSolver::SetTimeout(atof(i->second.c_str()));
+    } else if (i->first == "max_branch_cost") {
+      max_branch_cost = atof(i->second.c_str());
+    } else if (i->first == "solver_models") {
+      num_models = atoi(i->second.c_str());
+    } else if (i->first == "solver_window") {
+      solver_window = atoi(i->second.c_str());
+    } else if (i->first == "check_features") {
+      check_features = true;
+    } else if (i->first == "feature_threads") {
+      feature_threads = atoi(i->second.c_str());
+    } else if (i->first == "feature_min_rows") {
+      feature_min_rows = atoi(i->second.c_str());
+    } else {
+      fprintf(stderr, "Unknown option: --%s\n", i->first.c_str());
+      return 1;
+    }
+  }
+  if (options.count("solver_cache_dir")
+      && !crest::YicesSolver::EnablePersistentCache(options["solver_cache_dir"],
+                                                    argv[1])) {
+    return 1;
+  }
+  if (options.count("record_queries")
+      && !crest::YicesSolver::EnableQueryLog(options["record_queries"])) {
     return 1;
   }
 
@@ -96,6 +194,13 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  strategy->EnableSolverPool(num_solver_workers);
+  strategy->SetMaxBranchCost(max_branch_cost);
+  strategy->SetNumModels(num_models > 1 ? num_models : 1);
+  strategy->SetSolverWindow(solver_window > 0 ? solver_window : 0);
+  strategy->CheckIncrementalFeatures(check_features);
+  strategy->SetFeatureThreads(feature_threads > 1 ? feature_threads : 1,
+                              feature_min_rows > 0 ? feature_min_rows : 0);
   strategy->Run();
 
   delete strategy;
@@ -0,0 +1,235 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "base/yices_solver.h"
+#include "run_crest/solver_pool.h"
+
+using std::string;
+
+namespace crest {
+
+namespace {
+
+bool WriteAll(int fd, const char* buf, size_t n) {
+  while (n > 0) {
+    ssize_t k = write(fd, buf, n);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    buf += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool ReadAll(int fd, char* buf, size_t n) {
+  while (n > 0) {
+    ssize_t k = read(fd, buf, n);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    buf += k;
+    n -= k;
+  }
+  return true;
+}
+
+// Replies are flat byte strings of fixed-size values; sizes are size_t.
+template <typename T>
+void Append(string* out, const T& x) {
+  out->append((const char*)&x, sizeof(x));
+}
+
+void AppendSoln(string* out, const map<var_t,value_t>& soln) {
+  Append(out, soln.size());
+  for (map<var_t,value_t>::const_iterator i = soln.begin(); i != soln.end(); ++i) {
+    Append(out, i->first);
+    Append(out, i->second);
+  }
+}
+
+template <typename T>
+bool Read(int fd, T* x) {
+  return ReadAll(fd, (char*)x, sizeof(*x));
+}
+
+bool ReadSoln(int fd, map<var_t,value_t>* soln) {
+  soln->clear();
+  size_t n = 0;
+  if (!Read(fd, &n))
+    return false;
+  for (size_t i = 0; i < n; i++) {
+    var_t var;
+    value_t val;
+    if (!Read(fd, &var) || !Read(fd, &val))
+      return false;
+    soln->insert(soln->end(), std::make_pair(var, val));
+  }
+  return true;
+}
+
+}  // namespace
+
+
+SolverPool::SolverPool(size_t num_workers)
+  : num_workers_(num_workers), ex_(NULL),
+    num_started_(0), num_collected_(0), wait_secs_(0.0) { }
+
+SolverPool::~SolverPool() {
+  Cancel();
+}
+
+void SolverPool::RunWorker(const SymbolicExecution& ex, size_t idx, int fd) {
+  // The worker owns a private copy of the execution, so negating the
+  // constraint in place is harmless.
+  ex.path().constraints()[idx]->Negate();
+  map<var_t,value_t> soln;
+  vector<CachedAnswer> answers;
+  YicesSolver::ResetStats();
+  YicesSolver::RecordCachedAnswers(&answers);
+  bool windowed = false;
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  bool sat = YicesSolver::IncrementalSolve(ex, idx, &soln, &windowed);
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+  YicesSolver::RecordCachedAnswers(NULL);
+
+  // Reply: a status byte, whether the query was windowed, the solution,
+  // the solver statistics and solve time of the query, and the answers it
+  // added to the cache.
+  string reply(1, sat ? 1 : 0);
+  reply.push_back(windowed ? 1 : 0);
+  AppendSoln(&reply, soln);
+  Append(&reply, YicesSolver::stats());
+  Append(&reply, secs);
+  Append(&reply, answers.size());
+  for (size_t i = 0; i < answers.size(); i++) {
+    const vector<hash_t>& key = answers[i].key;
+    Append(&reply, key.size());
+    for (size_t j = 0; j < key.size(); j++) {
+      Append(&reply, key[j]);
+    }
+    Append(&reply, static_cast<char>(answers[i].sat));
+    AppendSoln(&reply, answers[i].soln);
+  }
+  WriteAll(fd, reply.data(), reply.size());
+  close(fd);
+}
+
+void SolverPool::Start(const SymbolicExecution& ex, const vector<size_t>& idxs) {
+  Cancel();
+  ex_ = &ex;
+  fflush(NULL);
+  for (size_t i = 0; i < idxs.size(); i++) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      continue;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+      perror("fork");
+      close(fds[0]);
+      close(fds[1]);
+      continue;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      RunWorker(ex, idxs[i], fds[1]);
+      _exit(0);
+    }
+    close(fds[1]);
+    Worker w = { pid, fds[0] };
+    workers_[idxs[i]] = w;
+    num_started_++;
+  }
+}
+
+bool SolverPool::Pending(const SymbolicExecution& ex, size_t idx) const {
+  return (&ex == ex_) && (workers_.find(idx) != workers_.end());
+}
+
+bool SolverPool::Wait(const SymbolicExecution& ex, size_t idx,
+                      bool* sat, map<var_t,value_t>* soln, bool* windowed,
+                      double* solve_secs) {
+  assert(Pending(ex, idx));
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  Worker w = workers_[idx];
+  workers_.erase(idx);
+
+  char status = 0;
+  char truncated = 0;
+  SolverStats stats;
+  size_t num_answers = 0;
+  bool ok = Read(w.fd, &status) && Read(w.fd, &truncated)
+    && ReadSoln(w.fd, soln) && Read(w.fd, &stats) && Read(w.fd, solve_secs)
+    && Read(w.fd, &num_answers);
+  vector<CachedAnswer> answers(ok ? num_answers : 0);
+  for (size_t i = 0; ok && (i < answers.size()); i++) {
+    size_t key_size = 0;
+    char sat = 0;
+    ok = Read(w.fd, &key_size);
+    if (ok) {
+      answers[i].key.resize(key_size);
+      for (size_t j = 0; ok && (j < key_size); j++) {
+        ok = Read(w.fd, &answers[i].key[j]);
+      }
+      ok = ok && Read(w.fd, &sat) && ReadSoln(w.fd, &answers[i].soln);
+      answers[i].sat = (sat != 0);
+    }
+  }
+  close(w.fd);
+  waitpid(w.pid, NULL, 0);
+  gettimeofday(&end, NULL);
+  wait_secs_ += (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+  if (!ok) {
+    fprintf(stderr, "Solver worker for constraint %zu died.\n", idx);
+    soln->clear();
+    return false;
+  }
+  *sat = (status != 0);
+  *windowed = (truncated != 0);
+  num_collected_++;
+
+  // The query's solving happened in the worker: account for it here.
+  YicesSolver::AddStats(stats);
+  for (size_t i = 0; i < answers.size(); i++) {
+    YicesSolver::AddCachedAnswer(answers[i]);
+  }
+  return true;
+}
+
+void SolverPool::Cancel() {
+  for (map<size_t,Worker>::iterator i = workers_.begin(); i != workers_.end(); ++i) {
+    kill(i->second.pid, SIGKILL);
+    close(i->second.fd);
+    waitpid(i->second.pid, NULL, 0);
+  }
+  workers_.clear();
+  ex_ = NULL;
+}
+
+}  // namespace crest
@@ -0,0 +1,85 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+#ifndef RUN_CREST_SOLVER_POOL_H__
+#define RUN_CREST_SOLVER_POOL_H__
+
+#include <map>
+#include <sys/types.h>
+#include <vector>
+
+#include "base/basic_types.h"
+#include "base/symbolic_execution.h"
+
+using std::map;
+using std::vector;
+
+namespace crest {
+
+// Solves several branch negations of one execution speculatively, in
+// parallel.  Yices keeps global state and is not thread-safe, so each
+// query runs in a forked worker process (which sees the execution through
+// copy-on-write memory and gets its own Yices context) and sends its
+// answer back over a pipe.
+class SolverPool {
+ public:
+  explicit SolverPool(size_t num_workers);
+  ~SolverPool();
+
+  size_t num_workers() const { return num_workers_; }
+
+  // Cancels any outstanding queries, then starts one worker for the
+  // negation of each of the constraints 'idxs' of 'ex'.
+  void Start(const SymbolicExecution& ex, const vector<size_t>& idxs);
+
+  // Returns true if a query for constraint 'idx' of 'ex' was started and
+  // has not been collected yet.
+  bool Pending(const SymbolicExecution& ex, size_t idx) const;
+
+  // Waits for the query for constraint 'idx' of 'ex' (which must be
+  // pending) and stores whether it was satisfiable in '*sat', the values
+  // of the slice's variables in 'soln', whether only the solver window
+  // was solved in '*windowed', and the seconds the worker spent solving
+  // in '*solve_secs'.  The worker's solver statistics and cached answers
+  // are added to this process's.  Returns false if the worker failed to
+  // answer.
+  bool Wait(const SymbolicExecution& ex, size_t idx,
+            bool* sat, map<var_t,value_t>* soln, bool* windowed,
+            double* solve_secs);
+
+  // Kills and reaps every outstanding worker.
+  void Cancel();
+
+  // Statistics: queries started, answers collected by Wait, and the
+  // total time spent in Wait.
+  unsigned num_started() const { return num_started_; }
+  unsigned num_collected() const { return num_collected_; }
+  double wait_secs() const { return wait_secs_; }
+
+ private:
+  struct Worker {
+    pid_t pid;
+    int fd;
+  };
+
+  static void RunWorker(const SymbolicExecution& ex, size_t idx, int fd);
+
+  const size_t num_workers_;
+  const SymbolicExecution* ex_;
+  map<size_t,Worker> workers_;
+
+  unsigned num_started_;
+  unsigned num_collected_;
+  double wait_secs_;
+};
+
+}  // namespace crest
+
+#endif  // RUN_CREST_SOLVER_POOL_H__
@@ -0,0 +1,161 @@
+// Copyright (c) 2008, Jacob Burnim (jburnim@cs.berkeley.edu)
+//
+// This file is part of CREST, which is distributed under the revised
+// BSD license.  A copy of this license can be found in the file LICENSE.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See LICENSE
+// for details.
+
+// Replays a query log recorded by run_crest --record_queries=FILE against
+// each solver configuration, and reports latency percentiles.
+//
+//   bench_solver <query log> [configuration ...]
+//
+// Configurations (all by default):
+//   recorded          the times recorded during the run
+//   yices             a fresh Yices context per query (integers)
+//   yices_bv          a fresh Yices context per query (bit-vectors)
+//   fast              the fast path alone (UNKNOWN answers are counted)
+//   fast+yices        the fast path, then Yices
+//   cache+fast+yices  the cache, the fast path, then Yices, in log order
+
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+#include "base/fast_solver.h"
+#include "base/query_log.h"
+#include "base/solver_cache.h"
+#include "base/yices_solver.h"
+
+using namespace crest;
+using namespace std;
+
+namespace {
+
+double WallTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+const char* kConfigs[] = {
+  "recorded", "yices", "yices_bv", "fast", "fast+yices", "cache+fast+yices"
+};
+const size_t kNumConfigs = sizeof(kConfigs) / sizeof(kConfigs[0]);
+
+enum Answer { UNSAT = 0, SAT = 1, UNKNOWN = 2 };
+
+// Answers 'q' under configuration 'config', using 'cache' (if not NULL)
+// in front of the fast path.
+Answer Replay(const string& config, const LoggedQuery& q, SolverCache* cache) {
+  vector<value_t> old_soln;
+  q.OldSolution(&old_soln);
+  map<var_t,value_t> soln;
+
+  if (config == "recorded") {
+    return q.sat() ? SAT : UNSAT;
+  } else if ((config == "yices") || (config == "yices_bv")) {
+    return YicesSolver::Solve(q.vars(), q.constraints(), &soln) ? SAT : UNSAT;
+  }
+
+  // The tiers of YicesSolver::IncrementalSolve, in order.
+  SolverCache::Key key;
+  bool sat;
+  if (cache && (cache->Lookup(old_soln, q.vars(), q.constraints(), &key, &soln, &sat)
+                != SolverCache::MISS)) {
+    return sat ? SAT : UNSAT;
+  }
+  switch (FastSolver::Solve(old_soln, q.vars(), q.constraints(), &soln)) {
+    case FastSolver::SAT:     sat = true; break;
+    case FastSolver::UNSAT:   sat = false; break;
+    case FastSolver::UNKNOWN:
+      if (config == "fast")
+        return UNKNOWN;
+      sat = YicesSolver::Solve(q.vars(), q.constraints(), &soln);
+      break;
+  }
+  if (cache)
+    cache->Insert(key, sat, soln);
+  return sat ? SAT : UNSAT;
+}
+
+double Percentile(const vector<double>& sorted, double p) {
+  if (sorted.empty())
+    return 0.0;
+  size_t i = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Syntax: bench_solver <query log> [configuration ...]\n");
+    fprintf(stderr, "  Configurations:");
+    for (size_t i = 0; i < kNumConfigs; i++)
+      fprintf(stderr, " %s", kConfigs[i]);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+
+  vector<string> configs;
+  for (int i = 2; i < argc; i++) {
+    if (find(kConfigs, kConfigs + kNumConfigs, string(argv[i])) == kConfigs + kNumConfigs) {
+      fprintf(stderr, "Unknown configuration: %s\n", argv[i]);
+      return 1;
+    }
+    configs.push_back(argv[i]);
+  }
+  if (configs.empty())
+    configs.assign(kConfigs, kConfigs + kNumConfigs);
+
+  printf("%-17s %7s %7s %7s %7s %6s %9s %9s %9s %9s %9s\n",
+         "configuration", "queries", "sat", "unsat", "unknown", "differ",
+         "total(s)", "p50(ms)", "p90(ms)", "p99(ms)", "max(ms)");
+
+  for (size_t c = 0; c < configs.size(); c++) {
+    const string& config = configs[c];
+    YicesSolver::EnableBitVectors(config == "yices_bv");
+    SolverCache cache;
+
+    ifstream in(argv[1], ios::in | ios::binary);
+    if (!in) {
+      perror(argv[1]);
+      return 1;
+    }
+
+    // Answers that differ from the recorded ones (not counting timed-out
+    // or unknown queries) point at a bug or an encoding difference.
+    unsigned count[3] = { 0, 0, 0 };
+    unsigned num_differ = 0;
+    vector<double> secs;
+    double total = 0.0;
+    LoggedQuery q;
+    while (q.Parse(in)) {
+      double start = WallTime();
+      Answer a = Replay(config, q, (config == "cache+fast+yices") ? &cache : NULL);
+      double t = (config == "recorded") ? q.secs() : WallTime() - start;
+      secs.push_back(t);
+      total += t;
+      count[a]++;
+      if ((a != UNKNOWN) && (q.tier() != tiers::TIMEOUT) && ((a == SAT) != q.sat()))
+        num_differ++;
+    }
+
+    sort(secs.begin(), secs.end());
+    printf("%-17s %7zu %7u %7u %7u %6u %9.3lf %9.3lf %9.3lf %9.3lf %9.3lf\n",
+           config.c_str(), secs.size(), count[SAT], count[UNSAT], count[UNKNOWN],
+           num_differ, total,
+           1000 * Percentile(secs, 0.50), 1000 * Percentile(secs, 0.90),
+           1000 * Percentile(secs, 0.99), secs.empty() ? 0.0 : 1000 * secs.back());
+  }
+
+  return 0;
+}